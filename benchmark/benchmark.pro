@@ -0,0 +1,30 @@
+TEMPLATE = app
+TARGET = grefsen-bench
+QT = core
+CONFIG += console link_pkgconfig
+CONFIG -= app_bundle
+QMAKE_CXXFLAGS += -std=c++17
+PKGCONFIG += wayland-client
+
+SOURCES += main.cpp
+
+# client code for xdg-shell, generated by wayland-scanner
+WAYLAND_PROTOCOLS_DIR = $$system(pkg-config --variable=pkgdatadir wayland-protocols)
+WAYLAND_SCANNER = $$system(pkg-config --variable=wayland_scanner wayland-scanner)
+WAYLAND_CLIENT_PROTOCOLS = $$WAYLAND_PROTOCOLS_DIR/stable/xdg-shell/xdg-shell.xml
+
+wayland_client_header.input = WAYLAND_CLIENT_PROTOCOLS
+wayland_client_header.output = ${QMAKE_FILE_BASE}-client-protocol.h
+wayland_client_header.commands = $$WAYLAND_SCANNER client-header < ${QMAKE_FILE_IN} > ${QMAKE_FILE_OUT}
+wayland_client_header.variable_out = HEADERS
+wayland_client_header.CONFIG += target_predeps no_link
+
+wayland_client_code.input = WAYLAND_CLIENT_PROTOCOLS
+wayland_client_code.output = ${QMAKE_FILE_BASE}-protocol.c
+wayland_client_code.commands = $$WAYLAND_SCANNER private-code < ${QMAKE_FILE_IN} > ${QMAKE_FILE_OUT}
+wayland_client_code.variable_out = SOURCES
+
+QMAKE_EXTRA_COMPILERS += wayland_client_header wayland_client_code
+
+OBJECTS_DIR = .obj
+MOC_DIR = .moc
@@ -0,0 +1,439 @@
+/*
+    Runs a headless grefsen (--headless) and a number of synthetic Wayland
+    clients, each with one xdg_toplevel drawn into shm buffers, and prints
+    one line per measurement:
+
+        create_rate 412.3 windows/s
+
+    With --json, the results are also written to a file, to keep track of
+    them from one commit to the next.
+
+    Moving and raising windows needs pointer input, which a client can't
+    provide; those are done by the compositor itself, on request via its
+    stdin (see HeadlessDriver).
+*/
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QProcess>
+#include <QSettings>
+#include <QThread>
+#include <QVector>
+
+#include <wayland-client.h>
+#include "xdg-shell-client-protocol.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static const int BufferCount = 3;
+
+struct Buffer
+{
+    wl_buffer *buffer = nullptr;
+    int width = 0;
+    int height = 0;
+    bool busy = false;
+};
+
+struct Client
+{
+    wl_display *display = nullptr;
+    wl_registry *registry = nullptr;
+    wl_compositor *compositor = nullptr;
+    wl_shm *shm = nullptr;
+    xdg_wm_base *wmBase = nullptr;
+
+    wl_surface *surface = nullptr;
+    xdg_surface *xdgSurface = nullptr;
+    xdg_toplevel *toplevel = nullptr;
+    bool configured = false;
+    bool frameDone = true;
+    int frames = 0;
+
+    // normal size, then a bigger one for resizing
+    Buffer buffers[2][BufferCount];
+    void *memory = nullptr;
+    size_t memorySize = 0;
+};
+
+// ---- protocol listeners
+
+static void bufferRelease(void *data, wl_buffer *)
+{
+    static_cast<Buffer *>(data)->busy = false;
+}
+static const wl_buffer_listener bufferListener = { bufferRelease };
+
+static void wmBasePing(void *, xdg_wm_base *wmBase, uint32_t serial)
+{
+    xdg_wm_base_pong(wmBase, serial);
+}
+static const xdg_wm_base_listener wmBaseListener = { wmBasePing };
+
+static void xdgSurfaceConfigure(void *data, xdg_surface *xdgSurface, uint32_t serial)
+{
+    xdg_surface_ack_configure(xdgSurface, serial);
+    static_cast<Client *>(data)->configured = true;
+}
+static const xdg_surface_listener xdgSurfaceListener = { xdgSurfaceConfigure };
+
+static void toplevelConfigure(void *, xdg_toplevel *, int32_t, int32_t, wl_array *) { }
+static void toplevelClose(void *, xdg_toplevel *) { }
+// xdg_wm_base is bound at version 1, so the later events never arrive
+static const xdg_toplevel_listener toplevelListener = { toplevelConfigure, toplevelClose };
+
+static void frameDone(void *data, wl_callback *callback, uint32_t)
+{
+    Client *client = static_cast<Client *>(data);
+    client->frameDone = true;
+    ++client->frames;
+    wl_callback_destroy(callback);
+}
+static const wl_callback_listener frameListener = { frameDone };
+
+static void registryGlobal(void *data, wl_registry *registry, uint32_t name, const char *interface, uint32_t)
+{
+    Client *client = static_cast<Client *>(data);
+    if (!strcmp(interface, wl_compositor_interface.name)) {
+        client->compositor = static_cast<wl_compositor *>(wl_registry_bind(registry, name, &wl_compositor_interface, 4));
+    } else if (!strcmp(interface, wl_shm_interface.name)) {
+        client->shm = static_cast<wl_shm *>(wl_registry_bind(registry, name, &wl_shm_interface, 1));
+    } else if (!strcmp(interface, xdg_wm_base_interface.name)) {
+        client->wmBase = static_cast<xdg_wm_base *>(wl_registry_bind(registry, name, &xdg_wm_base_interface, 1));
+        xdg_wm_base_add_listener(client->wmBase, &wmBaseListener, client);
+    }
+}
+static void registryGlobalRemove(void *, wl_registry *, uint32_t) { }
+static const wl_registry_listener registryListener = { registryGlobal, registryGlobalRemove };
+
+// ---- clients
+
+static bool connectClient(Client *client, const QByteArray &socketName)
+{
+    client->display = wl_display_connect(socketName.constData());
+    if (!client->display)
+        return false;
+    client->registry = wl_display_get_registry(client->display);
+    wl_registry_add_listener(client->registry, &registryListener, client);
+    wl_display_roundtrip(client->display);
+    return client->compositor && client->shm && client->wmBase;
+}
+
+static bool createBuffers(Client *client, int width, int height, int bigWidth, int bigHeight)
+{
+    const size_t normalSize = size_t(width) * height * 4;
+    const size_t bigSize = size_t(bigWidth) * bigHeight * 4;
+    client->memorySize = (normalSize + bigSize) * BufferCount;
+    int fd = memfd_create("grefsen-bench", MFD_CLOEXEC);
+    if (fd < 0 || ftruncate(fd, off_t(client->memorySize)) < 0)
+        return false;
+    client->memory = mmap(nullptr, client->memorySize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (client->memory == MAP_FAILED)
+        return false;
+    // opaque, so that occlusion culling applies as it would to a real application
+    memset(client->memory, 0x80, client->memorySize);
+    wl_shm_pool *pool = wl_shm_create_pool(client->shm, fd, int32_t(client->memorySize));
+    size_t offset = 0;
+    for (int s = 0; s < 2; ++s) {
+        const int w = s ? bigWidth : width;
+        const int h = s ? bigHeight : height;
+        for (int i = 0; i < BufferCount; ++i) {
+            Buffer &b = client->buffers[s][i];
+            b.width = w;
+            b.height = h;
+            b.buffer = wl_shm_pool_create_buffer(pool, int32_t(offset), w, h, w * 4, WL_SHM_FORMAT_XRGB8888);
+            wl_buffer_add_listener(b.buffer, &bufferListener, &b);
+            offset += size_t(w) * h * 4;
+        }
+    }
+    wl_shm_pool_destroy(pool);
+    close(fd);
+    return true;
+}
+
+// a buffer that the compositor has released, waiting for one if need be
+static Buffer *freeBuffer(Client *client, int sizeIndex)
+{
+    for (;;) {
+        for (Buffer &b : client->buffers[sizeIndex])
+            if (!b.busy)
+                return &b;
+        if (wl_display_dispatch(client->display) < 0)
+            return nullptr;
+    }
+}
+
+static void commitBuffer(Client *client, int sizeIndex, bool requestFrame)
+{
+    Buffer *b = freeBuffer(client, sizeIndex);
+    if (!b)
+        return;
+    b->busy = true;
+    wl_surface_attach(client->surface, b->buffer, 0, 0);
+    wl_surface_damage_buffer(client->surface, 0, 0, b->width, b->height);
+    if (requestFrame) {
+        client->frameDone = false;
+        wl_callback_add_listener(wl_surface_frame(client->surface), &frameListener, client);
+    }
+    wl_surface_commit(client->surface);
+}
+
+static bool mapWindow(Client *client, int index)
+{
+    client->surface = wl_compositor_create_surface(client->compositor);
+    wl_region *opaque = wl_compositor_create_region(client->compositor);
+    wl_region_add(opaque, 0, 0, client->buffers[1][0].width, client->buffers[1][0].height);
+    wl_surface_set_opaque_region(client->surface, opaque);
+    wl_region_destroy(opaque);
+    client->xdgSurface = xdg_wm_base_get_xdg_surface(client->wmBase, client->surface);
+    xdg_surface_add_listener(client->xdgSurface, &xdgSurfaceListener, client);
+    client->toplevel = xdg_surface_get_toplevel(client->xdgSurface);
+    xdg_toplevel_add_listener(client->toplevel, &toplevelListener, client);
+    xdg_toplevel_set_app_id(client->toplevel, "grefsen-bench");
+    xdg_toplevel_set_title(client->toplevel, QByteArray("bench " + QByteArray::number(index)).constData());
+    wl_surface_commit(client->surface);
+    while (!client->configured)
+        if (wl_display_dispatch(client->display) < 0)
+            return false;
+    commitBuffer(client, 0, false);
+    return wl_display_roundtrip(client->display) >= 0;
+}
+
+static void destroyWindow(Client *client)
+{
+    xdg_toplevel_destroy(client->toplevel);
+    xdg_surface_destroy(client->xdgSurface);
+    wl_surface_destroy(client->surface);
+    client->toplevel = nullptr;
+    client->xdgSurface = nullptr;
+    client->surface = nullptr;
+    client->configured = false;
+}
+
+static void disconnectClient(Client *client)
+{
+    for (auto &size : client->buffers)
+        for (Buffer &b : size)
+            if (b.buffer)
+                wl_buffer_destroy(b.buffer);
+    if (client->memory && client->memory != MAP_FAILED)
+        munmap(client->memory, client->memorySize);
+    if (client->display)
+        wl_display_disconnect(client->display);
+}
+
+// ---- the compositor
+
+static qint64 residentKiB(qint64 pid)
+{
+    QFile status(QStringLiteral("/proc/%1/status").arg(pid));
+    if (!status.open(QIODevice::ReadOnly))
+        return 0;
+    const QList<QByteArray> lines = status.readAll().split('\n');
+    for (const QByteArray &line : lines)
+        if (line.startsWith("VmRSS:"))
+            return line.mid(6).trimmed().split(' ').first().toLongLong();
+    return 0;
+}
+
+static QList<QByteArray> driverCommand(QProcess &compositor, const QByteArray &command)
+{
+    compositor.write(command + '\n');
+    compositor.waitForBytesWritten();
+    while (!compositor.canReadLine())
+        if (!compositor.waitForReadyRead(60000))
+            return QList<QByteArray>();
+    return compositor.readLine().trimmed().split(' ');
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Grefsen benchmark: synthetic Wayland clients against a headless compositor");
+    parser.addHelpOption();
+    QCommandLineOption windowsOption(QStringList() << "n" << "windows", "number of clients, with one window each", "count", "50");
+    QCommandLineOption sizeOption("size", "window size", "WxH", "400x300");
+    QCommandLineOption outputsOption("outputs", "virtual output sizes", "WxH[,WxH...]", "1920x1080");
+    QCommandLineOption secondsOption("seconds", "duration of each throughput test", "seconds", "3");
+    QCommandLineOption compositorOption("compositor", "the compositor to run", "path",
+                                        QCoreApplication::applicationDirPath() + "/../grefsen");
+    QCommandLineOption jsonOption("json", "also write the results to a JSON file", "path");
+    parser.addOption(windowsOption);
+    parser.addOption(sizeOption);
+    parser.addOption(outputsOption);
+    parser.addOption(secondsOption);
+    parser.addOption(compositorOption);
+    parser.addOption(jsonOption);
+    parser.process(app);
+
+    const int windowCount = qMax(1, parser.value(windowsOption).toInt());
+    const QList<QByteArray> wh = parser.value(sizeOption).toLatin1().split('x');
+    const int width = qMax(1, wh.value(0).toInt());
+    const int height = qMax(1, wh.value(1).toInt());
+    const qint64 duration = qMax(1, parser.value(secondsOption).toInt()) * 1000;
+
+    QJsonObject results;
+    auto report = [&results](const char *name, double value, const char *unit) {
+        printf("%-24s %12.3f %s\n", name, value, unit);
+        fflush(stdout);
+        results.insert(QLatin1String(name), value);
+    };
+
+    // a private config dir: no screen.qml, no prewarming, nothing from the user's session
+    const QByteArray socketName = "grefsen-bench-" + QByteArray::number(QCoreApplication::applicationPid());
+    const QString configDir = QDir::tempPath() + "/" + QString::fromLatin1(socketName) + "/";
+    QDir().mkpath(configDir);
+    {
+        // the frame rates depend on the pacing policy; don't let a change of its defaults change the results
+        QSettings config(configDir + "grefsen/grefsen.conf", QSettings::IniFormat);
+        config.beginGroup(QStringLiteral("pacing"));
+        config.setValue(QStringLiteral("unfocusedFps"), 30);
+        config.setValue(QStringLiteral("hiddenFps"), 1);
+        config.endGroup();
+    }
+    QProcess compositor;
+    QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
+    env.insert("XDG_CONFIG_HOME", configDir);
+    compositor.setProcessEnvironment(env);
+    compositor.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    compositor.start(parser.value(compositorOption), QStringList() << "--headless" << parser.value(outputsOption)
+                     << "--wayland-socket-name" << QString::fromLatin1(socketName) << "-c" << configDir);
+    if (!compositor.waitForStarted()) {
+        fprintf(stderr, "failed to start %s: %s\n", qPrintable(parser.value(compositorOption)),
+                qPrintable(compositor.errorString()));
+        return 1;
+    }
+    const QString socketPath = qEnvironmentVariable("XDG_RUNTIME_DIR") + "/" + QString::fromLatin1(socketName);
+    QElapsedTimer timer;
+    timer.start();
+    while (!QFileInfo::exists(socketPath) && timer.elapsed() < 20000)
+        QThread::msleep(10);
+    if (!QFileInfo::exists(socketPath)) {
+        fprintf(stderr, "the compositor did not create %s\n", qPrintable(socketPath));
+        return 1;
+    }
+    report("startup", timer.nsecsElapsed() / 1e6, "ms");
+
+    QVector<Client> clients(windowCount);
+    for (Client &client : clients) {
+        if (!connectClient(&client, socketName) || !createBuffers(&client, width, height, width + 50, height + 50)) {
+            fprintf(stderr, "failed to connect a client\n");
+            return 1;
+        }
+    }
+    const qint64 rssBefore = residentKiB(compositor.processId());
+
+    // windows created and mapped, one after another
+    timer.start();
+    for (int i = 0; i < windowCount; ++i)
+        if (!mapWindow(&clients[i], i))
+            return 1;
+    report("create_rate", windowCount / (timer.nsecsElapsed() / 1e9), "windows/s");
+    driverCommand(compositor, "move 1"); // let everything be rendered once
+    report("memory_per_window", qreal(residentKiB(compositor.processId()) - rssBefore) / windowCount, "KiB");
+
+    // commits as fast as the compositor takes them
+    timer.start();
+    qint64 commits = 0;
+    while (timer.elapsed() < duration) {
+        for (Client &client : clients) {
+            commitBuffer(&client, 0, false);
+            wl_display_flush(client.display);
+        }
+        for (Client &client : clients)
+            wl_display_roundtrip(client.display);
+        commits += windowCount;
+    }
+    report("commit_throughput", commits / (timer.nsecsElapsed() / 1e9), "commits/s");
+
+    // each client drawing whenever it gets a frame callback, as a real one would
+    for (Client &client : clients) {
+        client.frames = 0;
+        commitBuffer(&client, 0, true);
+        wl_display_flush(client.display);
+    }
+    QVector<pollfd> fds(windowCount);
+    for (int i = 0; i < windowCount; ++i)
+        fds[i] = { wl_display_get_fd(clients[i].display), POLLIN, 0 };
+    timer.start();
+    while (timer.elapsed() < duration) {
+        if (poll(fds.data(), nfds_t(fds.size()), 100) <= 0)
+            continue;
+        for (int i = 0; i < windowCount; ++i) {
+            Client &client = clients[i];
+            if (fds[i].revents & POLLIN)
+                wl_display_dispatch(client.display);
+            if (client.frameDone) {
+                commitBuffer(&client, 0, true);
+                wl_display_flush(client.display);
+            }
+        }
+    }
+    int frames = 0;
+    for (const Client &client : clients)
+        frames += client.frames;
+    report("paced_fps_per_window", frames / (timer.nsecsElapsed() / 1e9) / windowCount, "FPS");
+    for (Client &client : clients)
+        while (!client.frameDone && wl_display_dispatch(client.display) >= 0)
+            ;
+
+    // resizing: alternating buffer sizes, each commit waiting for the compositor
+    const int resizes = 20;
+    timer.start();
+    for (int r = 0; r < resizes; ++r) {
+        for (Client &client : clients) {
+            commitBuffer(&client, (r + 1) % 2, false);
+            wl_display_roundtrip(client.display);
+        }
+    }
+    report("resize_cost", timer.nsecsElapsed() / 1e3 / (resizes * windowCount), "us/resize");
+
+    // interactive operations, done by the compositor itself
+    QList<QByteArray> reply = driverCommand(compositor, "raise 10");
+    if (reply.value(0) == "raise") {
+        report("raise_cost", reply.value(2).toDouble(), "us/raise");
+        report("raise_frame_time", reply.value(3).toDouble(), "ms/frame");
+    }
+    reply = driverCommand(compositor, "move 100");
+    if (reply.value(0) == "move")
+        report("move_frame_time", reply.value(2).toDouble(), "ms/frame");
+
+    timer.start();
+    for (Client &client : clients) {
+        destroyWindow(&client);
+        wl_display_roundtrip(client.display);
+    }
+    report("destroy_rate", windowCount / (timer.nsecsElapsed() / 1e9), "windows/s");
+
+    for (Client &client : clients)
+        disconnectClient(&client);
+    driverCommand(compositor, "quit");
+    if (!compositor.waitForFinished(5000))
+        compositor.kill();
+    QDir(configDir).removeRecursively();
+
+    if (parser.isSet(jsonOption)) {
+        QFile f(parser.value(jsonOption));
+        if (!f.open(QIODevice::WriteOnly)) {
+            fprintf(stderr, "failed to write %s\n", qPrintable(f.fileName()));
+            return 1;
+        }
+        results.insert(QLatin1String("windows"), windowCount);
+        results.insert(QLatin1String("size"), parser.value(sizeOption));
+        results.insert(QLatin1String("outputs"), parser.value(outputsOption));
+        f.write(QJsonDocument(results).toJson());
+    }
+    return 0;
+}
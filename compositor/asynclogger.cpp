@@ -0,0 +1,269 @@
+#include "asynclogger.h"
+
+#include <QThread>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static const qint64 BufferSize = 256 * 1024;
+static const qint64 BatchBytes = 64 * 1024; // wake the writer early once this much is queued
+static const int WriterInterval = 100; // ms
+static const int FlushSpins = 100000;
+
+AsyncLogger *AsyncLogger::instance()
+{
+    static AsyncLogger logger;
+    return &logger;
+}
+
+AsyncLogger::AsyncLogger()
+    : m_head(&m_stub)
+    , m_tail(&m_stub)
+{
+    m_stub.next.store(nullptr, std::memory_order_relaxed);
+    m_stub.length = 0;
+}
+
+AsyncLogger::~AsyncLogger()
+{
+    stop();
+}
+
+bool AsyncLogger::start(const QString &path, const QElapsedTimer &clock, Format format, qint64 maxBytes, int keepFiles)
+{
+    m_path = path.toLocal8Bit();
+    m_clock = clock;
+    m_format = format;
+    m_maxBytes = maxBytes;
+    m_keepFiles = keepFiles;
+    m_buffer = static_cast<char *>(malloc(BufferSize));
+    // keep the log of the previous run (which may have crashed) rather than truncating it
+    if (m_keepFiles > 0 && access(m_path.constData(), F_OK) == 0)
+        rotate();
+    else
+        m_fd = ::open(m_path.constData(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (m_fd < 0) {
+        fprintf(stderr, "failed to open log file %s: %s\n", m_path.constData(), strerror(errno));
+        free(m_buffer);
+        m_buffer = nullptr;
+        return false;
+    }
+    m_writer = QThread::create([this]() { run(); });
+    m_writer->setObjectName(QLatin1String("log writer"));
+    m_writer->start(QThread::LowPriority);
+    return true;
+}
+
+void AsyncLogger::stop()
+{
+    if (!m_writer)
+        return;
+    m_quit.store(true, std::memory_order_release);
+    m_wake.wakeOne();
+    m_writer->wait();
+    delete m_writer;
+    m_writer = nullptr;
+    ::close(m_fd);
+    m_fd = -1;
+    free(m_buffer);
+    m_buffer = nullptr;
+}
+
+void AsyncLogger::log(QtMsgType type, const QMessageLogContext &context, const QString &msg)
+{
+    char typeChar = ' ';
+    switch (type) {
+    case QtDebugMsg:
+        typeChar = 'd';
+        break;
+    case QtInfoMsg:
+        typeChar = 'i';
+        break;
+    case QtWarningMsg:
+        typeChar = 'W';
+        break;
+    case QtCriticalMsg:
+        typeChar = '!';
+        break;
+    case QtFatalMsg:
+        typeChar = 'F';
+    }
+    const qint64 ts = m_clock.elapsed();
+    const QByteArray text = msg.toUtf8();
+    const char *category = context.category ? context.category : "default";
+
+    // measure first, then format straight into the record
+    char header[64];
+    int headerLength;
+    int functionLength = 0;
+    if (m_format == Compact) {
+        headerLength = snprintf(header, sizeof(header), "%lld %c ", ts, typeChar);
+        functionLength = snprintf(nullptr, 0, "%s: ", category);
+    } else {
+        headerLength = snprintf(header, sizeof(header), "[%6lld.%03lld %c] ", ts / 1000, ts % 1000, typeChar);
+        if (context.function)
+            functionLength = snprintf(nullptr, 0, "%s:%d: ", context.function, context.line);
+    }
+    const int length = headerLength + functionLength + text.length() + 1;
+    Record *record = static_cast<Record *>(malloc(sizeof(Record) + length));
+    if (!record)
+        return;
+    record->length = length;
+    char *p = record->data;
+    memcpy(p, header, headerLength);
+    p += headerLength;
+    if (m_format == Compact)
+        snprintf(p, functionLength + 1, "%s: ", category);
+    else if (context.function)
+        snprintf(p, functionLength + 1, "%s:%d: ", context.function, context.line);
+    p += functionLength;
+    memcpy(p, text.constData(), text.length());
+    p[text.length()] = '\n';
+
+    push(record);
+    const qint64 queued = m_queuedBytes.fetch_add(length, std::memory_order_relaxed) + length;
+    if (queued > BatchBytes || type != QtDebugMsg)
+        m_wake.wakeOne();
+}
+
+void AsyncLogger::push(Record *record)
+{
+    record->next.store(nullptr, std::memory_order_relaxed);
+    Record *prev = m_head.exchange(record, std::memory_order_acq_rel);
+    prev->next.store(record, std::memory_order_release);
+}
+
+// only while holding the consumer lock
+AsyncLogger::Record *AsyncLogger::pop()
+{
+    Record *tail = m_tail;
+    Record *next = tail->next.load(std::memory_order_acquire);
+    if (tail == &m_stub) {
+        if (!next)
+            return nullptr;
+        m_tail = next;
+        tail = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+    if (next) {
+        m_tail = next;
+        return tail;
+    }
+    // a producer has swapped the head but not linked its record yet; get it next time
+    if (tail != m_head.load(std::memory_order_acquire))
+        return nullptr;
+    push(&m_stub);
+    next = tail->next.load(std::memory_order_acquire);
+    if (next) {
+        m_tail = next;
+        return tail;
+    }
+    return nullptr;
+}
+
+bool AsyncLogger::tryLockConsumer(int spins)
+{
+    for (int i = 0; i < spins; ++i) {
+        bool expected = false;
+        if (m_consuming.compare_exchange_weak(expected, true, std::memory_order_acquire))
+            return true;
+        sched_yield();
+    }
+    return false;
+}
+
+// freeRecords is false in the crash handler, where free() is not safe
+void AsyncLogger::drain(bool freeRecords)
+{
+    while (Record *record = pop()) {
+        if (m_buffered + record->length > BufferSize) {
+            writeOut(m_buffer, m_buffered);
+            m_buffered = 0;
+        }
+        if (record->length > BufferSize) {
+            writeOut(record->data, record->length);
+        } else {
+            memcpy(m_buffer + m_buffered, record->data, record->length);
+            m_buffered += record->length;
+        }
+        m_queuedBytes.fetch_sub(record->length, std::memory_order_relaxed);
+        if (freeRecords)
+            free(record);
+    }
+    if (m_buffered) {
+        writeOut(m_buffer, m_buffered);
+        m_buffered = 0;
+    }
+    if (freeRecords && m_maxBytes > 0 && m_fileSize > m_maxBytes)
+        rotate();
+}
+
+void AsyncLogger::writeOut(const char *data, qint64 length)
+{
+    while (length > 0 && m_fd >= 0) {
+        ssize_t written = ::write(m_fd, data, size_t(length));
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+        data += written;
+        length -= written;
+        m_fileSize += written;
+    }
+}
+
+void AsyncLogger::rotate()
+{
+    if (m_fd >= 0)
+        ::close(m_fd);
+    for (int i = m_keepFiles - 1; i > 0; --i) {
+        QByteArray from = m_path + '.' + QByteArray::number(i);
+        QByteArray to = m_path + '.' + QByteArray::number(i + 1);
+        ::rename(from.constData(), to.constData());
+    }
+    if (m_keepFiles > 0)
+        ::rename(m_path.constData(), (m_path + ".1").constData());
+    m_fd = ::open(m_path.constData(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    m_fileSize = 0;
+}
+
+void AsyncLogger::run()
+{
+    while (!m_quit.load(std::memory_order_acquire)) {
+        if (tryLockConsumer(1)) {
+            drain(true);
+            unlockConsumer();
+        }
+        QMutexLocker lock(&m_wakeMutex);
+        if (m_queuedBytes.load(std::memory_order_relaxed) <= BatchBytes)
+            m_wake.wait(&m_wakeMutex, WriterInterval);
+    }
+    if (tryLockConsumer(FlushSpins)) {
+        drain(true);
+        unlockConsumer();
+    }
+}
+
+void AsyncLogger::flush()
+{
+    if (m_fd < 0 || !tryLockConsumer(FlushSpins))
+        return;
+    drain(true);
+    unlockConsumer();
+}
+
+void AsyncLogger::crashFlush()
+{
+    // the writer thread may be in the middle of a batch; give it a moment to finish,
+    // but don't wait forever: it may be the thread that crashed
+    if (m_fd < 0 || !m_buffer || !tryLockConsumer(FlushSpins))
+        return;
+    drain(false);
+    ::fsync(m_fd);
+}
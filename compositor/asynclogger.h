@@ -0,0 +1,85 @@
+#ifndef ASYNCLOGGER_H
+#define ASYNCLOGGER_H
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QString>
+#include <QWaitCondition>
+#include <atomic>
+
+class QThread;
+
+/*!
+    The backend for --log: the message handler formats each message into a
+    record and pushes it onto a lock-free queue (any number of threads may
+    log at once without blocking each other), and a writer thread gathers
+    whatever has queued up into large write() calls. The log file is rotated
+    when it grows beyond a size limit: grefsen.log becomes grefsen.log.1 and
+    so on.
+
+    start() returns false if the log file can't be opened; then there is
+    no writer, and the message handler should not be installed.
+
+    flush() writes everything queued so far on the calling thread; it's
+    used for QtFatalMsg. crashFlush() does the same using only
+    async-signal-safe calls, for the crash handler.
+*/
+class AsyncLogger
+{
+public:
+    enum Format {
+        Text,   // [seconds.ms t] function:line: message
+        Compact // ms t category: message
+    };
+
+    static AsyncLogger *instance();
+
+    bool start(const QString &path, const QElapsedTimer &clock, Format format, qint64 maxBytes, int keepFiles);
+    void stop();
+    void log(QtMsgType type, const QMessageLogContext &context, const QString &msg);
+    void flush();
+    void crashFlush();
+
+private:
+    struct Record {
+        std::atomic<Record *> next;
+        int length;
+        char data[1];
+    };
+
+    AsyncLogger();
+    ~AsyncLogger();
+
+    void push(Record *record);
+    Record *pop();
+    bool tryLockConsumer(int spins);
+    void unlockConsumer() { m_consuming.store(false, std::memory_order_release); }
+    void drain(bool freeRecords);
+    void writeOut(const char *data, qint64 length);
+    void rotate();
+    void run();
+
+    // Vyukov's intrusive multiple-producer single-consumer queue
+    std::atomic<Record *> m_head;
+    Record *m_tail;
+    Record m_stub;
+
+    std::atomic<bool> m_consuming { false };
+    std::atomic<bool> m_quit { false };
+    std::atomic<qint64> m_queuedBytes { 0 };
+    QMutex m_wakeMutex;
+    QWaitCondition m_wake;
+    QThread *m_writer = nullptr;
+
+    QByteArray m_path;
+    QElapsedTimer m_clock;
+    Format m_format = Text;
+    qint64 m_maxBytes = 0;
+    int m_keepFiles = 0;
+    int m_fd = -1;
+    qint64 m_fileSize = 0;
+    char *m_buffer = nullptr;
+    qint64 m_buffered = 0;
+};
+
+#endif // ASYNCLOGGER_H
@@ -1,5 +1,5 @@
-QT += gui qml quick
-CONFIG += link_pkgconfig
+QT += gui qml quick waylandcompositor
+CONFIG += link_pkgconfig qtquickcompiler
 QMAKE_CXXFLAGS += -std=c++17
 TARGET = ../grefsen
 
@@ -12,7 +12,9 @@ INCLUDEPATH += /usr/include/glib-2.0 /usr/lib/glib-2.0/include
 OTHER_FILES = \
     qml/main.qml \
     qml/Output.qml \
-    qml/Chrome.qml
+    qml/Chrome.qml \
+    qml/FrameProfilerHud.qml \
+    qml/WindowSwitcherPanel.qml
 
 RESOURCES += grefsen.qrc
 
@@ -0,0 +1,199 @@
+#include "damagetracker.h"
+
+#include <QLoggingCategory>
+#include <QtWaylandCompositor/QWaylandQuickItem>
+#include <QtWaylandCompositor/QWaylandSurface>
+
+Q_LOGGING_CATEGORY(lcDamage, "grefsen.compositor.damage")
+
+static const int StatsInterval = 1000;
+static const qreal FullFrameRatio = 0.9; // damage covering this much of the window may as well be a full repaint
+static const qreal AverageWeight = 0.05; // exponential moving average over roughly the last 20 frames
+
+static qint64 area(const QRegion &region)
+{
+    qint64 ret = 0;
+    for (const QRect &r : region)
+        ret += qint64(r.width()) * r.height();
+    return ret;
+}
+
+DamageTracker::DamageTracker(QObject *parent)
+    : QObject(parent)
+{
+    m_statsTimer.setInterval(StatsInterval);
+    connect(&m_statsTimer, &QTimer::timeout, this, &DamageTracker::publishStats);
+}
+
+void DamageTracker::setWindow(QQuickWindow *window)
+{
+    if (m_window == window)
+        return;
+    if (m_window)
+        disconnect(m_window, nullptr, this, nullptr);
+    m_window = window;
+    if (window) {
+        connect(window, &QQuickWindow::afterAnimating, this, &DamageTracker::checkItems);
+        connect(window, &QQuickWindow::beforeSynchronizing, this, &DamageTracker::frameStarted, Qt::DirectConnection);
+        connect(window, &QWindow::widthChanged, this, &DamageTracker::invalidate);
+        connect(window, &QWindow::heightChanged, this, &DamageTracker::invalidate);
+        m_statsTimer.start();
+    } else {
+        m_statsTimer.stop();
+    }
+    invalidate();
+    emit windowChanged();
+}
+
+int DamageTracker::frameCount() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_frameCount;
+}
+
+int DamageTracker::fullFrameCount() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_fullFrameCount;
+}
+
+QRect DamageTracker::lastDamageBounds() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_lastBounds;
+}
+
+qreal DamageTracker::lastDamageRatio() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_lastRatio;
+}
+
+qreal DamageTracker::averageDamageRatio() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_averageRatio;
+}
+
+void DamageTracker::trackItem(QQuickItem *item)
+{
+    if (!item || m_trackedItems.contains(item))
+        return;
+    m_trackedItems.insert(item);
+    // geometry and visibility are checked every frame (see checkItems()); opacity doesn't change the rect
+    connect(item, &QQuickItem::opacityChanged, this, [this, item]() { itemChanged(item); });
+    connect(item, &QObject::destroyed, this, [this, item]() {
+        addDamage(m_itemRects.take(item));
+        m_surfaceConnections.remove(item);
+        m_trackedItems.remove(item);
+    });
+    if (QWaylandQuickItem *surfaceItem = qobject_cast<QWaylandQuickItem *>(item)) {
+        connect(surfaceItem, &QWaylandQuickItem::surfaceChanged, this, [this, item]() { connectSurface(item); });
+        connectSurface(item);
+    }
+    itemChanged(item);
+}
+
+void DamageTracker::connectSurface(QQuickItem *item)
+{
+    disconnect(m_surfaceConnections.value(item));
+    QWaylandSurface *surface = static_cast<QWaylandQuickItem *>(item)->surface();
+    if (surface)
+        m_surfaceConnections.insert(item, connect(surface, &QWaylandSurface::damaged, this,
+                                                  [this, item](const QRegion &region) { surfaceDamaged(item, region); }));
+    else
+        m_surfaceConnections.insert(item, QMetaObject::Connection());
+}
+
+void DamageTracker::itemChanged(QQuickItem *item)
+{
+    QRectF old = m_itemRects.value(item);
+    QRectF current;
+    if (item->isVisible() && item->window() == m_window)
+        current = item->mapRectToScene(item->boundingRect());
+    if (current.isEmpty())
+        m_itemRects.remove(item);
+    else
+        m_itemRects.insert(item, current);
+    addDamage(old);
+    addDamage(current);
+}
+
+// on the GUI thread, before each frame: catches items that moved along with a parent,
+// or by an animated transform, which their own geometry signals don't report
+void DamageTracker::checkItems()
+{
+    for (QQuickItem *item : qAsConst(m_trackedItems)) {
+        QRectF current;
+        if (item->isVisible() && item->window() == m_window)
+            current = item->mapRectToScene(item->boundingRect());
+        if (current.isEmpty())
+            current = QRectF();
+        if (current != m_itemRects.value(item))
+            itemChanged(item);
+    }
+}
+
+void DamageTracker::surfaceDamaged(QQuickItem *item, const QRegion &region)
+{
+    if (!item->isVisible() || item->window() != m_window)
+        return;
+    QWaylandSurface *surface = static_cast<QWaylandQuickItem *>(item)->surface();
+    const QSize size = surface ? surface->destinationSize() : QSize();
+    if (size.isEmpty()) {
+        addDamage(item->mapRectToScene(item->boundingRect()));
+        return;
+    }
+    // surface coordinates -> item coordinates -> scene
+    const qreal sx = item->width() / size.width();
+    const qreal sy = item->height() / size.height();
+    for (const QRect &r : region)
+        addDamage(item->mapRectToScene(QRectF(r.x() * sx, r.y() * sy, r.width() * sx, r.height() * sy)));
+}
+
+void DamageTracker::addDamage(const QRectF &sceneRect)
+{
+    if (sceneRect.isEmpty())
+        return;
+    QMutexLocker lock(&m_mutex);
+    if (!m_full)
+        m_pending += sceneRect.toAlignedRect();
+}
+
+void DamageTracker::invalidate()
+{
+    QMutexLocker lock(&m_mutex);
+    m_full = true;
+    m_pending = QRegion();
+}
+
+void DamageTracker::frameStarted()
+{
+    QQuickWindow *window = m_window;
+    if (!window)
+        return;
+    const QRect bounds(QPoint(), window->size());
+    const qint64 windowArea = qint64(bounds.width()) * bounds.height();
+    QMutexLocker lock(&m_mutex);
+    QRegion damage = m_full ? QRegion(bounds) : m_pending.intersected(bounds);
+    m_pending = QRegion();
+    m_full = false;
+    qreal ratio = windowArea > 0 ? qreal(area(damage)) / windowArea : 1;
+    ++m_frameCount;
+    if (ratio >= FullFrameRatio)
+        ++m_fullFrameCount;
+    m_lastBounds = damage.boundingRect();
+    m_lastRatio = ratio;
+    m_averageRatio += (ratio - m_averageRatio) * AverageWeight;
+}
+
+void DamageTracker::publishStats()
+{
+    const int frames = frameCount();
+    if (frames == m_publishedFrameCount)
+        return;
+    m_publishedFrameCount = frames;
+    qCDebug(lcDamage) << m_window << "frames" << frames << "full" << fullFrameCount()
+                      << "last damage" << lastDamageBounds() << "average ratio" << averageDamageRatio();
+    emit statsChanged();
+}
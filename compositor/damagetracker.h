@@ -0,0 +1,88 @@
+#ifndef DAMAGETRACKER_H
+#define DAMAGETRACKER_H
+
+#include <QHash>
+#include <QMutex>
+#include <QPointer>
+#include <QQuickItem>
+#include <QQuickWindow>
+#include <QRegion>
+#include <QSet>
+#include <QTimer>
+
+class QWaylandSurface;
+
+/*!
+    Measures how much of an output's window changes from one frame to the
+    next: buffers committed by clients (as reported by the surfaces'
+    damage), and tracked items that move, resize, appear or disappear, such
+    as window chrome and the cursor. When the scene graph synchronizes, the
+    accumulated damage is counted towards the statistics, which are
+    published once per second.
+
+    Anything that is not tracked (e.g. animations in screen.qml) can report
+    damage with addDamage() or invalidate().
+
+    This is for measurement only: Qt Quick still renders the whole window
+    every frame, so the statistics show how much partial repainting would
+    save, not what is actually repainted.
+*/
+class DamageTracker : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(QQuickWindow *window READ window WRITE setWindow NOTIFY windowChanged)
+    Q_PROPERTY(int frameCount READ frameCount NOTIFY statsChanged)
+    Q_PROPERTY(int fullFrameCount READ fullFrameCount NOTIFY statsChanged)
+    Q_PROPERTY(QRect lastDamageBounds READ lastDamageBounds NOTIFY statsChanged)
+    Q_PROPERTY(qreal lastDamageRatio READ lastDamageRatio NOTIFY statsChanged)
+    Q_PROPERTY(qreal averageDamageRatio READ averageDamageRatio NOTIFY statsChanged)
+
+public:
+    explicit DamageTracker(QObject *parent = nullptr);
+
+    QQuickWindow *window() const { return m_window; }
+    void setWindow(QQuickWindow *window);
+
+    int frameCount() const;
+    int fullFrameCount() const;
+    QRect lastDamageBounds() const;
+    qreal lastDamageRatio() const;
+    qreal averageDamageRatio() const;
+
+    Q_INVOKABLE void trackItem(QQuickItem *item);
+    Q_INVOKABLE void addDamage(const QRectF &sceneRect);
+
+signals:
+    void windowChanged();
+    void statsChanged();
+
+public slots:
+    void invalidate();
+
+protected:
+    void itemChanged(QQuickItem *item);
+    void checkItems();
+    void surfaceDamaged(QQuickItem *item, const QRegion &region);
+    void connectSurface(QQuickItem *item);
+    void frameStarted(); // on the render thread, while the GUI thread is blocked
+    void publishStats();
+
+protected:
+    QPointer<QQuickWindow> m_window;
+    QSet<QQuickItem *> m_trackedItems;
+    QHash<QQuickItem *, QRectF> m_itemRects; // last known scene rect of each tracked, visible item
+    QHash<QQuickItem *, QMetaObject::Connection> m_surfaceConnections;
+    QTimer m_statsTimer;
+    int m_publishedFrameCount = 0;
+
+    mutable QMutex m_mutex; // the rest is accessed from the render thread too
+    QRegion m_pending;
+    bool m_full = true;
+    int m_frameCount = 0;
+    int m_fullFrameCount = 0;
+    QRect m_lastBounds;
+    qreal m_lastRatio = 1;
+    qreal m_averageRatio = 1;
+};
+
+#endif // DAMAGETRACKER_H
@@ -0,0 +1,289 @@
+#include "framepacer.h"
+#include "surfaceviewtracker.h"
+
+#include <QFile>
+#include <QLoggingCategory>
+#include <QSettings>
+#include <QtWaylandCompositor/QWaylandClient>
+#include <QtWaylandCompositor/QWaylandCompositor>
+#include <QtWaylandCompositor/QWaylandSeat>
+#include <QtWaylandCompositor/QWaylandSurface>
+#include <QtWaylandCompositor/QWaylandView>
+
+Q_LOGGING_CATEGORY(lcPacing, "grefsen.compositor.pacing")
+
+static const qreal SuspendedFps = -1;
+
+FramePacer::FramePacer(QObject *parent)
+    : QObject(parent)
+{
+    QSettings settings;
+    settings.beginGroup(QStringLiteral("pacing"));
+    m_unfocusedFps = settings.value(QStringLiteral("unfocusedFps"), m_unfocusedFps).toReal();
+    m_hiddenFps = settings.value(QStringLiteral("hiddenFps"), m_hiddenFps).toReal();
+    settings.endGroup();
+    settings.beginGroup(QStringLiteral("pacingPerApp"));
+    const QStringList apps = settings.childKeys();
+    for (const QString &app : apps)
+        m_appFps.insert(app, settings.value(app).toReal());
+
+    m_clock.start();
+    m_timer.setTimerType(Qt::PreciseTimer);
+    connect(&m_timer, &QTimer::timeout, this, &FramePacer::sendThrottledCallbacks);
+}
+
+FramePacer::~FramePacer()
+{
+    const QList<QWaylandSurface *> parked = m_parked.keys();
+    for (QWaylandSurface *surface : parked)
+        unpark(surface);
+}
+
+void FramePacer::setCompositor(QWaylandCompositor *compositor)
+{
+    if (m_compositor == compositor)
+        return;
+    if (m_compositor)
+        disconnect(m_compositor, nullptr, this, nullptr);
+    m_compositor = compositor;
+    if (compositor) {
+        connect(compositor, &QWaylandCompositor::defaultSeatChanged, this, &FramePacer::seatChanged);
+        seatChanged(compositor->defaultSeat());
+    }
+    emit compositorChanged();
+}
+
+void FramePacer::seatChanged(QWaylandSeat *seat)
+{
+    if (m_seat == seat)
+        return;
+    if (m_seat)
+        disconnect(m_seat, nullptr, this, nullptr);
+    m_seat = seat;
+    if (seat)
+        connect(seat, &QWaylandSeat::keyboardFocusChanged, this, &FramePacer::updateThrottling);
+    updateThrottling();
+}
+
+void FramePacer::setUnfocusedFps(qreal fps)
+{
+    if (qFuzzyCompare(m_unfocusedFps, fps))
+        return;
+    m_unfocusedFps = fps;
+    emit policyChanged();
+    updateThrottling();
+}
+
+void FramePacer::setHiddenFps(qreal fps)
+{
+    if (qFuzzyCompare(m_hiddenFps, fps))
+        return;
+    m_hiddenFps = fps;
+    emit policyChanged();
+    updateThrottling();
+}
+
+void FramePacer::setOutputState(QObject *output, const QSet<QWaylandSurface *> &visible,
+                                const QSet<QWaylandSurface *> &hidden, const QSet<QWaylandSurface *> &moving)
+{
+    OutputState state { visible, hidden, moving };
+    auto it = m_outputs.find(output);
+    if (it == m_outputs.end())
+        connect(output, &QObject::destroyed, this, &FramePacer::outputDestroyed);
+    else if (*it == state)
+        return;
+    for (QWaylandSurface *surface : visible + hidden)
+        know(surface);
+    m_outputs.insert(output, state);
+    updateThrottling();
+}
+
+void FramePacer::setSuspended(const QList<QWaylandSurface *> &surfaces, bool suspended)
+{
+    bool changed = false;
+    for (QWaylandSurface *surface : surfaces) {
+        if (!surface || m_suspended.contains(surface) == suspended)
+            continue;
+        know(surface);
+        if (suspended)
+            m_suspended.insert(surface);
+        else
+            m_suspended.remove(surface);
+        changed = true;
+    }
+    if (changed)
+        updateThrottling();
+}
+
+void FramePacer::know(QWaylandSurface *surface)
+{
+    if (m_known.contains(surface))
+        return;
+    m_known.insert(surface);
+    connect(surface, &QObject::destroyed, this, [this, surface]() { forget(surface); });
+}
+
+void FramePacer::outputDestroyed(QObject *output)
+{
+    m_outputs.remove(output);
+    updateThrottling();
+}
+
+void FramePacer::forget(QWaylandSurface *surface)
+{
+    m_known.remove(surface);
+    m_suspended.remove(surface);
+    m_appIds.remove(surface);
+    m_processNames.remove(surface);
+    for (OutputState &state : m_outputs) {
+        state.visible.remove(surface);
+        state.hidden.remove(surface);
+        state.moving.remove(surface);
+    }
+    if (m_parked.contains(surface)) {
+        delete m_parked.take(surface).parkingView;
+        emit throttlingChanged();
+    }
+}
+
+// called for every surface whenever the throttling is updated, so remember what was found;
+// the shell's id is looked for until there is one, since the client may set it after the first frame
+QString FramePacer::appId(QWaylandSurface *surface) const
+{
+    auto cached = m_appIds.constFind(surface);
+    if (cached != m_appIds.constEnd())
+        return *cached;
+    if (SurfaceViewTracker *tracker = SurfaceViewTracker::trackerFor(surface)) {
+        QString ret = tracker->topLevel() ? tracker->topLevel()->property("appId").toString() : QString();
+        if (ret.isEmpty() && tracker->shellSurface())
+            ret = tracker->shellSurface()->property("className").toString(); // wl_shell
+        if (!ret.isEmpty()) {
+            m_appIds.insert(surface, ret);
+            return ret;
+        }
+    }
+    cached = m_processNames.constFind(surface);
+    if (cached != m_processNames.constEnd())
+        return *cached;
+    if (!surface->client())
+        return QString();
+    QString ret;
+    QFile comm(QStringLiteral("/proc/%1/comm").arg(surface->client()->processId()));
+    if (comm.open(QIODevice::ReadOnly))
+        ret = QString::fromLocal8Bit(comm.readAll().trimmed());
+    m_processNames.insert(surface, ret);
+    return ret;
+}
+
+qreal FramePacer::policyFps(QWaylandSurface *surface, const QSet<QWaylandSurface *> &visible,
+                            const QSet<QWaylandSurface *> &moving) const
+{
+    if (m_suspended.contains(surface))
+        return SuspendedFps;
+    if (!visible.contains(surface))
+        return m_hiddenFps;
+    if (moving.contains(surface) || (m_seat && m_seat->keyboardFocus() == surface))
+        return 0;
+    if (!m_appFps.isEmpty()) {
+        auto it = m_appFps.constFind(appId(surface));
+        if (it != m_appFps.constEnd())
+            return *it;
+    }
+    return m_unfocusedFps;
+}
+
+void FramePacer::updateThrottling()
+{
+    QSet<QWaylandSurface *> visible;
+    QSet<QWaylandSurface *> moving;
+    for (const OutputState &state : qAsConst(m_outputs)) {
+        visible += state.visible;
+        moving += state.moving;
+    }
+
+    bool changed = false;
+    for (QWaylandSurface *surface : qAsConst(m_known)) {
+        const qreal fps = policyFps(surface, visible, moving);
+        auto parked = m_parked.find(surface);
+        if (qFuzzyIsNull(fps)) {
+            if (parked != m_parked.end()) {
+                unpark(surface);
+                changed = true;
+            }
+        } else if (parked == m_parked.end()) {
+            park(surface, fps);
+            changed = true;
+        } else if (!qFuzzyCompare(parked->fps, fps)) {
+            qCDebug(lcPacing) << "throttling" << surface << "to" << fps << "FPS";
+            parked->fps = fps;
+            changed = true;
+        }
+    }
+    if (!changed)
+        return;
+
+    // tick as often as the fastest throttled surface needs
+    qreal maxFps = 0;
+    for (const Parked &parked : qAsConst(m_parked))
+        maxFps = qMax(maxFps, parked.fps);
+    if (maxFps > 0)
+        m_timer.start(qMax(1, qRound(1000 / maxFps)));
+    else
+        m_timer.stop();
+    emit throttlingChanged();
+}
+
+void FramePacer::park(QWaylandSurface *surface, qreal fps)
+{
+    Parked parked;
+    parked.primaryView = surface->primaryView();
+    parked.parkingView = new QWaylandView(this);
+    parked.parkingView->setSurface(surface);
+    parked.parkingView->setPrimary();
+    parked.fps = fps;
+    parked.lastSent = m_clock.elapsed();
+    m_parked.insert(surface, parked);
+    qCDebug(lcPacing) << "throttling" << surface << appId(surface) << "to" << fps << "FPS";
+}
+
+void FramePacer::unpark(QWaylandSurface *surface)
+{
+    Parked parked = m_parked.take(surface);
+    if (parked.primaryView && parked.primaryView->surface() == surface)
+        parked.primaryView->setPrimary();
+    delete parked.parkingView;
+    // it has waited long enough
+    surface->sendFrameCallbacks();
+    qCDebug(lcPacing) << "no longer throttling" << surface;
+}
+
+void FramePacer::sendThrottledCallbacks()
+{
+    const qint64 now = m_clock.elapsed();
+    // within half a tick counts as due
+    const qint64 slack = m_timer.interval() / 2;
+    for (auto it = m_parked.begin(); it != m_parked.end(); ++it) {
+        if (it->fps > 0 && now - it->lastSent + slack >= qRound64(1000 / it->fps)) {
+            it.key()->sendFrameCallbacks();
+            it->lastSent = now;
+        }
+    }
+}
+
+qreal FramePacer::allottedFps(QWaylandSurface *surface) const
+{
+    auto it = m_parked.constFind(surface);
+    return it == m_parked.constEnd() ? 0 : it->fps;
+}
+
+QVariantList FramePacer::clients() const
+{
+    QVariantList ret;
+    for (auto it = m_parked.constBegin(); it != m_parked.constEnd(); ++it) {
+        QVariantMap m;
+        m.insert(QStringLiteral("appId"), appId(it.key()));
+        m.insert(QStringLiteral("fps"), it->fps);
+        ret << m;
+    }
+    return ret;
+}
@@ -0,0 +1,131 @@
+#ifndef FRAMEPACER_H
+#define FRAMEPACER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QPointer>
+#include <QSet>
+#include <QTimer>
+#include <QVariantList>
+
+class QWaylandCompositor;
+class QWaylandSeat;
+class QWaylandSurface;
+class QWaylandView;
+
+/*!
+    Decides how often each client gets frame callbacks. Normally a surface
+    gets one after each frame rendered on the output where its primary view
+    is; a surface that is throttled has its primary view parked on a
+    QWaylandView that isn't on any output, so that the outputs skip it, and
+    gets its callbacks from a timer instead, at its allotted rate:
+
+    \list
+    \li full rate, for the window with keyboard focus and windows that are
+        being moved or resized
+    \li \c unfocusedFps for other windows, or a rate configured for the
+        particular application (by app id, or else executable name)
+    \li \c hiddenFps for windows that can't be seen at all, because they
+        are covered by opaque windows (see OcclusionCuller) or off-screen,
+        on every output that they are on
+    \li none at all, for windows that are suspended because they are on a
+        workspace that isn't shown (see WorkspaceManager)
+    \endlist
+
+    \code
+    [pacing]
+    unfocusedFps=30
+    hiddenFps=1
+
+    [pacingPerApp]
+    mpv=60
+    \endcode
+
+    A rate of 0 means no limit.
+*/
+class FramePacer : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(QWaylandCompositor *compositor READ compositor WRITE setCompositor NOTIFY compositorChanged)
+    Q_PROPERTY(qreal unfocusedFps READ unfocusedFps WRITE setUnfocusedFps NOTIFY policyChanged)
+    Q_PROPERTY(qreal hiddenFps READ hiddenFps WRITE setHiddenFps NOTIFY policyChanged)
+    Q_PROPERTY(int throttledCount READ throttledCount NOTIFY throttlingChanged)
+    Q_PROPERTY(QVariantList clients READ clients NOTIFY throttlingChanged)
+
+public:
+    explicit FramePacer(QObject *parent = nullptr);
+    ~FramePacer() override;
+
+    QWaylandCompositor *compositor() const { return m_compositor; }
+    void setCompositor(QWaylandCompositor *compositor);
+    qreal unfocusedFps() const { return m_unfocusedFps; }
+    void setUnfocusedFps(qreal fps);
+    qreal hiddenFps() const { return m_hiddenFps; }
+    void setHiddenFps(qreal fps);
+
+    int throttledCount() const { return m_parked.count(); }
+    // for each throttled surface: app id and allotted FPS
+    QVariantList clients() const;
+
+    // what the output showed in the last frame: the surfaces that can be seen,
+    // those that can't (covered or off-screen), and those being moved or resized
+    void setOutputState(QObject *output, const QSet<QWaylandSurface *> &visible,
+                        const QSet<QWaylandSurface *> &hidden, const QSet<QWaylandSurface *> &moving);
+
+    // no frame callbacks at all for these surfaces, until they are resumed
+    void setSuspended(const QList<QWaylandSurface *> &surfaces, bool suspended);
+
+    Q_INVOKABLE bool isThrottled(QWaylandSurface *surface) const { return m_parked.contains(surface); }
+    Q_INVOKABLE bool isSuspended(QWaylandSurface *surface) const { return m_suspended.contains(surface); }
+    // 0 if not throttled; negative if suspended
+    Q_INVOKABLE qreal allottedFps(QWaylandSurface *surface) const;
+
+signals:
+    void compositorChanged();
+    void policyChanged();
+    void throttlingChanged();
+
+protected:
+    struct OutputState {
+        QSet<QWaylandSurface *> visible;
+        QSet<QWaylandSurface *> hidden;
+        QSet<QWaylandSurface *> moving;
+        bool operator==(const OutputState &o) const { return visible == o.visible && hidden == o.hidden && moving == o.moving; }
+    };
+    struct Parked {
+        QWaylandView *parkingView = nullptr;
+        QPointer<QWaylandView> primaryView;
+        qreal fps = 0;
+        qint64 lastSent = 0; // ms since m_clock started
+    };
+
+    void seatChanged(QWaylandSeat *seat);
+    void outputDestroyed(QObject *output);
+    void know(QWaylandSurface *surface);
+    void forget(QWaylandSurface *surface);
+    QString appId(QWaylandSurface *surface) const;
+    qreal policyFps(QWaylandSurface *surface, const QSet<QWaylandSurface *> &visible,
+                    const QSet<QWaylandSurface *> &moving) const;
+    void updateThrottling();
+    void park(QWaylandSurface *surface, qreal fps);
+    void unpark(QWaylandSurface *surface);
+    void sendThrottledCallbacks();
+
+protected:
+    QPointer<QWaylandCompositor> m_compositor;
+    QPointer<QWaylandSeat> m_seat;
+    QHash<QObject *, OutputState> m_outputs;
+    QHash<QWaylandSurface *, Parked> m_parked;
+    QSet<QWaylandSurface *> m_known;
+    QSet<QWaylandSurface *> m_suspended;
+    QHash<QString, qreal> m_appFps;
+    mutable QHash<QWaylandSurface *, QString> m_appIds; // from the shell
+    mutable QHash<QWaylandSurface *, QString> m_processNames; // until the shell has an id
+    QElapsedTimer m_clock;
+    QTimer m_timer;
+    qreal m_unfocusedFps = 30;
+    qreal m_hiddenFps = 1;
+};
+
+#endif // FRAMEPACER_H
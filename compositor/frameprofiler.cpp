@@ -0,0 +1,261 @@
+#include "frameprofiler.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLoggingCategory>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QtWaylandCompositor/QWaylandClient>
+#include <QtWaylandCompositor/QWaylandQuickItem>
+#include <QtWaylandCompositor/QWaylandSurface>
+#include <chrono>
+#include <climits>
+
+Q_LOGGING_CATEGORY(lcProfiler, "grefsen.compositor.profiler")
+
+static const int StatsInterval = 500;
+static const qint32 IdleInterval = 1000000; // µs; a longer gap between frames is not a slow frame
+
+static qint64 now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static qint32 usecs(qint64 nsecs)
+{
+    return qint32(qBound<qint64>(0, nsecs / 1000, INT_MAX));
+}
+
+static QString processName(qint64 pid)
+{
+    QFile f(QStringLiteral("/proc/%1/comm").arg(pid));
+    if (!f.open(QIODevice::ReadOnly))
+        return QString::number(pid);
+    return QString::fromLocal8Bit(f.readAll()).trimmed();
+}
+
+FrameProfiler::FrameProfiler(QObject *parent)
+    : QObject(parent)
+{
+    m_statsTimer.setInterval(StatsInterval);
+    connect(&m_statsTimer, &QTimer::timeout, this, &FrameProfiler::updateStats);
+}
+
+void FrameProfiler::setWindow(QQuickWindow *window)
+{
+    if (m_window == window)
+        return;
+    if (m_window)
+        disconnect(m_window, nullptr, this, nullptr);
+    m_window = window;
+    if (window) {
+        connect(window, &QQuickWindow::beforeSynchronizing, this, &FrameProfiler::beforeSynchronizing, Qt::DirectConnection);
+        connect(window, &QQuickWindow::afterSynchronizing, this, &FrameProfiler::afterSynchronizing, Qt::DirectConnection);
+        connect(window, &QQuickWindow::beforeRendering, this, &FrameProfiler::beforeRendering, Qt::DirectConnection);
+        connect(window, &QQuickWindow::afterRendering, this, &FrameProfiler::afterRendering, Qt::DirectConnection);
+        connect(window, &QQuickWindow::frameSwapped, this, &FrameProfiler::frameSwapped, Qt::DirectConnection);
+        m_statsTimer.start();
+    } else {
+        m_statsTimer.stop();
+    }
+    emit windowChanged();
+}
+
+void FrameProfiler::trackItem(QQuickItem *item)
+{
+    QWaylandQuickItem *surfaceItem = qobject_cast<QWaylandQuickItem *>(item);
+    if (!surfaceItem || m_surfaceConnections.contains(item))
+        return;
+    auto connectSurface = [this, surfaceItem]() {
+        disconnect(m_surfaceConnections.value(surfaceItem));
+        QMetaObject::Connection connection;
+        if (QWaylandSurface *surface = surfaceItem->surface())
+            connection = connect(surface, &QWaylandSurface::redraw, this, [this, surfaceItem]() { surfaceCommitted(surfaceItem); });
+        m_surfaceConnections.insert(surfaceItem, connection);
+    };
+    connect(surfaceItem, &QWaylandQuickItem::surfaceChanged, this, connectSurface);
+    connect(surfaceItem, &QObject::destroyed, this, [this, item]() { disconnect(m_surfaceConnections.take(item)); });
+    connectSurface();
+}
+
+void FrameProfiler::surfaceCommitted(QQuickItem *item)
+{
+    if (item->window() != m_window || !item->isVisible())
+        return;
+    QWaylandSurface *surface = static_cast<QWaylandQuickItem *>(item)->surface();
+    if (!surface || !surface->client())
+        return;
+    // the first commit since the last frame is the one that has waited longest
+    const qint64 pid = surface->client()->processId();
+    if (!m_pendingCommits.contains(pid))
+        m_pendingCommits.insert(pid, now());
+}
+
+// the GUI thread is blocked from here until afterSynchronizing
+void FrameProfiler::beforeSynchronizing()
+{
+    m_syncStart = now();
+    m_current = FrameRecord();
+    m_current.start = m_syncStart;
+    if (m_lastStart)
+        m_current.interval = usecs(m_syncStart - m_lastStart);
+    m_lastStart = m_syncStart;
+    for (auto it = m_pendingCommits.constBegin(); it != m_pendingCommits.constEnd(); ++it)
+        if (!m_inFlight.contains(it.key()))
+            m_inFlight.insert(it.key(), it.value());
+    m_pendingCommits.clear();
+}
+
+void FrameProfiler::afterSynchronizing()
+{
+    m_current.sync = usecs(now() - m_syncStart);
+}
+
+void FrameProfiler::beforeRendering()
+{
+    m_renderStart = now();
+}
+
+void FrameProfiler::afterRendering()
+{
+    m_renderEnd = now();
+    m_current.render = usecs(m_renderEnd - m_renderStart);
+}
+
+void FrameProfiler::frameSwapped()
+{
+    const qint64 t = now();
+    if (!m_current.start)
+        return;
+    m_current.number = m_ring.written();
+    m_current.swap = usecs(t - m_renderEnd);
+    m_current.commits = m_inFlight.count();
+    if (!m_inFlight.isEmpty()) {
+        QHash<qint64, qint64> latencies;
+        qint64 worst = 0;
+        for (auto it = m_inFlight.constBegin(); it != m_inFlight.constEnd(); ++it) {
+            latencies.insert(it.key(), t - it.value());
+            worst = qMax(worst, t - it.value());
+        }
+        m_current.latency = usecs(worst);
+        m_inFlight.clear();
+        QMetaObject::invokeMethod(this, [this, latencies]() { addLatencies(latencies); }, Qt::QueuedConnection);
+    }
+    m_ring.push(m_current);
+    m_current = FrameRecord();
+}
+
+void FrameProfiler::addLatencies(const QHash<qint64, qint64> &latencies)
+{
+    for (auto it = latencies.constBegin(); it != latencies.constEnd(); ++it) {
+        ClientStats &stats = m_clientStats[it.key()];
+        if (stats.name.isEmpty())
+            stats.name = processName(it.key());
+        ++stats.frames;
+        stats.totalLatency += it.value();
+        stats.maxLatency = qMax(stats.maxLatency, it.value());
+    }
+}
+
+QVariantList FrameProfiler::clients() const
+{
+    QVariantList ret;
+    for (auto it = m_clientStats.constBegin(); it != m_clientStats.constEnd(); ++it) {
+        QVariantMap client;
+        client.insert(QStringLiteral("pid"), it.key());
+        client.insert(QStringLiteral("name"), it->name);
+        client.insert(QStringLiteral("frames"), it->frames);
+        client.insert(QStringLiteral("averageLatency"), it->frames ? it->totalLatency / it->frames / 1e6 : 0.0);
+        client.insert(QStringLiteral("maxLatency"), it->maxLatency / 1e6);
+        ret << client;
+    }
+    return ret;
+}
+
+QVariantList FrameProfiler::recentFrameTimes(int count) const
+{
+    QVariantList ret;
+    const QVector<FrameRecord> recent = m_ring.recent(count);
+    for (const FrameRecord &r : recent)
+        ret << r.interval / 1000.0;
+    return ret;
+}
+
+void FrameProfiler::updateStats()
+{
+    const QVector<FrameRecord> recent = m_ring.recent(SummaryFrames);
+    if (recent.isEmpty())
+        return;
+    qint64 interval = 0, sync = 0, render = 0, swap = 0, latency = 0, maxInterval = 0;
+    int intervals = 0, latencies = 0, commits = 0;
+    for (const FrameRecord &r : recent) {
+        if (r.interval && r.interval < IdleInterval) {
+            interval += r.interval;
+            maxInterval = qMax<qint64>(maxInterval, r.interval);
+            ++intervals;
+        }
+        sync += r.sync;
+        render += r.render;
+        swap += r.swap;
+        if (r.commits) {
+            latency += r.latency;
+            ++latencies;
+        }
+        commits += r.commits;
+    }
+    const int n = recent.count();
+    m_averageFrameTime = intervals ? interval / 1000.0 / intervals : 0;
+    m_fps = m_averageFrameTime > 0 ? 1000 / m_averageFrameTime : 0;
+    m_maxFrameTime = maxInterval / 1000.0;
+    m_averageSyncTime = sync / 1000.0 / n;
+    m_averageRenderTime = render / 1000.0 / n;
+    m_averageSwapTime = swap / 1000.0 / n;
+    m_averageLatency = latencies ? latency / 1000.0 / latencies : 0;
+    m_commits = commits;
+    emit statsChanged();
+}
+
+bool FrameProfiler::dump(const QString &path) const
+{
+    const QVector<FrameRecord> all = m_ring.recent(BufferSize);
+    QSaveFile f(path);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        qWarning() << "failed to write frame profile" << path << f.errorString();
+        return false;
+    }
+    if (path.endsWith(QLatin1String(".json"), Qt::CaseInsensitive)) {
+        QJsonArray frames;
+        for (const FrameRecord &r : all) {
+            QJsonObject o;
+            o.insert(QStringLiteral("frame"), qint64(r.number));
+            o.insert(QStringLiteral("start_ns"), r.start);
+            o.insert(QStringLiteral("interval_us"), r.interval);
+            o.insert(QStringLiteral("sync_us"), r.sync);
+            o.insert(QStringLiteral("render_us"), r.render);
+            o.insert(QStringLiteral("swap_us"), r.swap);
+            o.insert(QStringLiteral("latency_us"), r.latency);
+            o.insert(QStringLiteral("commits"), r.commits);
+            frames.append(o);
+        }
+        QJsonObject doc;
+        doc.insert(QStringLiteral("output"), m_window ? m_window->title() : QString());
+        doc.insert(QStringLiteral("frames"), frames);
+        doc.insert(QStringLiteral("clients"), QJsonArray::fromVariantList(clients()));
+        f.write(QJsonDocument(doc).toJson());
+    } else {
+        QTextStream out(&f);
+        out << "frame,start_ns,interval_us,sync_us,render_us,swap_us,latency_us,commits\n";
+        for (const FrameRecord &r : all)
+            out << r.number << ',' << r.start << ',' << r.interval << ',' << r.sync << ',' << r.render << ','
+                << r.swap << ',' << r.latency << ',' << r.commits << '\n';
+    }
+    if (!f.commit()) {
+        qWarning() << "failed to write frame profile" << path << f.errorString();
+        return false;
+    }
+    qCDebug(lcProfiler) << "wrote" << all.count() << "frames to" << path;
+    return true;
+}
@@ -0,0 +1,176 @@
+#ifndef FRAMEPROFILER_H
+#define FRAMEPROFILER_H
+
+#include <QHash>
+#include <QPointer>
+#include <QQuickItem>
+#include <QQuickWindow>
+#include <QTimer>
+#include <QVariantList>
+#include <atomic>
+
+class QWaylandSurface;
+
+struct FrameRecord
+{
+    quint64 number = 0;
+    qint64 start = 0;    // ns, steady clock: when the scene graph started to synchronize
+    qint32 interval = 0; // µs since the previous frame started
+    qint32 sync = 0;     // µs in beforeSynchronizing..afterSynchronizing
+    qint32 render = 0;   // µs in beforeRendering..afterRendering
+    qint32 swap = 0;     // µs in afterRendering..frameSwapped
+    qint32 latency = 0;  // µs, worst commit-to-present of the clients committed for this frame
+    qint32 commits = 0;   // clients whose commits this frame presents
+};
+
+/*!
+    A fixed-size ring buffer with one writer and any number of readers,
+    none of which ever blocks: each slot has a sequence number that is odd
+    while the slot is being written, and readers skip the slots that change
+    while they copy them.
+*/
+template <typename T, int Size>
+class FrameRing
+{
+public:
+    void push(const T &value)
+    {
+        const quint64 n = m_written.load(std::memory_order_relaxed);
+        Slot &slot = m_slots[n % Size];
+        const quint64 seq = slot.seq.load(std::memory_order_relaxed);
+        slot.seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.value = value;
+        slot.seq.store(seq + 2, std::memory_order_release);
+        m_written.store(n + 1, std::memory_order_release);
+    }
+
+    // up to count of the most recent values, oldest first
+    QVector<T> recent(int count) const
+    {
+        QVector<T> ret;
+        const quint64 written = m_written.load(std::memory_order_acquire);
+        const quint64 n = qMin<quint64>(quint64(qMin(count, Size - 1)), written);
+        ret.reserve(int(n));
+        for (quint64 i = written - n; i < written; ++i) {
+            const Slot &slot = m_slots[i % Size];
+            const quint64 before = slot.seq.load(std::memory_order_acquire);
+            if (before & 1)
+                continue;
+            T copy = slot.value;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) == before)
+                ret.append(copy);
+        }
+        return ret;
+    }
+
+    quint64 written() const { return m_written.load(std::memory_order_acquire); }
+
+private:
+    struct Slot {
+        std::atomic<quint64> seq{0};
+        T value;
+    };
+    Slot m_slots[Size];
+    std::atomic<quint64> m_written{0};
+};
+
+/*!
+    Measures the frames of one output window: the time between frames, the
+    scene graph's sync, render and swap phases, how long it takes for a
+    client's commit to reach the screen, and how many clients' commits
+    each frame presents. Records are kept in a lock-free ring buffer written by
+    the render thread; the summary properties are updated twice a second,
+    and dump() writes the whole buffer as CSV or JSON.
+*/
+class FrameProfiler : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(QQuickWindow *window READ window WRITE setWindow NOTIFY windowChanged)
+    Q_PROPERTY(qreal fps READ fps NOTIFY statsChanged)
+    Q_PROPERTY(qreal averageFrameTime READ averageFrameTime NOTIFY statsChanged)
+    Q_PROPERTY(qreal maxFrameTime READ maxFrameTime NOTIFY statsChanged)
+    Q_PROPERTY(qreal averageSyncTime READ averageSyncTime NOTIFY statsChanged)
+    Q_PROPERTY(qreal averageRenderTime READ averageRenderTime NOTIFY statsChanged)
+    Q_PROPERTY(qreal averageSwapTime READ averageSwapTime NOTIFY statsChanged)
+    Q_PROPERTY(qreal averageLatency READ averageLatency NOTIFY statsChanged)
+    Q_PROPERTY(int commits READ commits NOTIFY statsChanged)
+    Q_PROPERTY(QVariantList clients READ clients NOTIFY statsChanged)
+
+public:
+    enum { BufferSize = 1024, SummaryFrames = 120 };
+
+    explicit FrameProfiler(QObject *parent = nullptr);
+
+    QQuickWindow *window() const { return m_window; }
+    void setWindow(QQuickWindow *window);
+
+    // all in ms
+    qreal fps() const { return m_fps; }
+    qreal averageFrameTime() const { return m_averageFrameTime; }
+    qreal maxFrameTime() const { return m_maxFrameTime; }
+    qreal averageSyncTime() const { return m_averageSyncTime; }
+    qreal averageRenderTime() const { return m_averageRenderTime; }
+    qreal averageSwapTime() const { return m_averageSwapTime; }
+    qreal averageLatency() const { return m_averageLatency; }
+    int commits() const { return m_commits; }
+    QVariantList clients() const;
+
+    QVector<FrameRecord> records(int count = BufferSize) const { return m_ring.recent(count); }
+    Q_INVOKABLE QVariantList recentFrameTimes(int count) const;
+    Q_INVOKABLE void trackItem(QQuickItem *item);
+    Q_INVOKABLE bool dump(const QString &path) const;
+
+signals:
+    void windowChanged();
+    void statsChanged();
+
+protected:
+    // on the render thread
+    void beforeSynchronizing();
+    void afterSynchronizing();
+    void beforeRendering();
+    void afterRendering();
+    void frameSwapped();
+
+    // on the GUI thread
+    void surfaceCommitted(QQuickItem *item);
+    void addLatencies(const QHash<qint64, qint64> &latencies);
+    void updateStats();
+
+protected:
+    struct ClientStats {
+        QString name;
+        int frames = 0;
+        qint64 totalLatency = 0; // ns
+        qint64 maxLatency = 0;   // ns
+    };
+
+    QPointer<QQuickWindow> m_window;
+    QTimer m_statsTimer;
+    FrameRing<FrameRecord, BufferSize> m_ring;
+
+    QHash<QQuickItem *, QMetaObject::Connection> m_surfaceConnections;
+    QHash<qint64, qint64> m_pendingCommits; // client pid -> first commit since the last sync
+    QHash<qint64, ClientStats> m_clientStats;
+
+    // render thread only
+    FrameRecord m_current;
+    QHash<qint64, qint64> m_inFlight;
+    qint64 m_syncStart = 0;
+    qint64 m_renderStart = 0;
+    qint64 m_renderEnd = 0;
+    qint64 m_lastStart = 0;
+
+    qreal m_fps = 0;
+    qreal m_averageFrameTime = 0;
+    qreal m_maxFrameTime = 0;
+    qreal m_averageSyncTime = 0;
+    qreal m_averageRenderTime = 0;
+    qreal m_averageSwapTime = 0;
+    qreal m_averageLatency = 0;
+    int m_commits = 0;
+};
+
+#endif // FRAMEPROFILER_H
@@ -0,0 +1,137 @@
+#include "fullscreenbypass.h"
+
+#include <QLoggingCategory>
+#include <QtWaylandCompositor/QWaylandQuickItem>
+#include <QtWaylandCompositor/QWaylandSurface>
+#include <algorithm>
+
+Q_LOGGING_CATEGORY(lcBypass, "grefsen.compositor.bypass")
+
+static const char *BypassHiddenProperty = "bypassHidden";
+
+static bool isShown(QQuickItem *view)
+{
+    return view->isVisible() || view->property(BypassHiddenProperty).toBool();
+}
+
+FullscreenBypass::FullscreenBypass(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void FullscreenBypass::setWindow(QQuickWindow *window)
+{
+    if (m_window == window)
+        return;
+    if (m_window)
+        disconnect(m_window, nullptr, this, nullptr);
+    m_window = window;
+    // on the GUI thread, once per frame, before the scene graph is synchronized
+    if (window)
+        connect(window, &QQuickWindow::afterAnimating, this, &FullscreenBypass::update);
+    emit windowChanged();
+}
+
+// the area changes with the workspace: the one left behind must not keep its views hidden
+void FullscreenBypass::setSurfaceArea(QQuickItem *surfaceArea)
+{
+    if (m_surfaceArea == surfaceArea)
+        return;
+    if (m_active)
+        apply(nullptr);
+    if (m_surfaceArea) {
+        const QList<QQuickItem *> views = m_surfaceArea->childItems();
+        for (QQuickItem *v : views)
+            if (v->property(BypassHiddenProperty).toBool())
+                v->setProperty(BypassHiddenProperty, false);
+    }
+    m_surfaceArea = surfaceArea;
+    emit surfaceAreaChanged();
+    update();
+}
+
+void FullscreenBypass::setEnabled(bool enabled)
+{
+    if (m_enabled == enabled)
+        return;
+    m_enabled = enabled;
+    emit enabledChanged();
+    update();
+}
+
+void FullscreenBypass::update()
+{
+    apply(m_enabled ? fullscreenView() : nullptr);
+}
+
+QQuickItem *FullscreenBypass::fullscreenView() const
+{
+    if (!m_window || !m_surfaceArea)
+        return nullptr;
+    // paint order, reversed: StackingManager orders the views by z, not by their order among the children
+    QList<QQuickItem *> views = m_surfaceArea->childItems();
+    std::reverse(views.begin(), views.end());
+    std::stable_sort(views.begin(), views.end(), [](const QQuickItem *a, const QQuickItem *b) {
+        return a->z() > b->z();
+    });
+    QQuickItem *top = nullptr;
+    for (auto it = views.cbegin(); it != views.cend() && !top; ++it)
+        if (isShown(*it))
+            top = *it;
+    // Chrome: fullscreen, not fading or animating, and exactly covering the output
+    if (!top || !top->property("fullscreen").toBool() || top->opacity() < 1 ||
+            top->property("moving").toBool())
+        return nullptr;
+    const QRectF bounds(QPointF(), m_window->size());
+    if (top->mapRectToScene(top->boundingRect()) != bounds)
+        return nullptr;
+    // and the client's buffer must hide everything too: with an alpha channel, the desktop shows through.
+    // The opaque region comes with a commit, and a commit makes a new frame, so it's checked again then.
+    QWaylandQuickItem *surfaceItem = qobject_cast<QWaylandQuickItem *>(top->property("shellSurfaceItem").value<QQuickItem *>());
+    QWaylandSurface *surface = surfaceItem ? surfaceItem->surface() : nullptr;
+    if (!surface || !surface->property("isOpaque").toBool() || surfaceItem->opacity() < 1 ||
+            surfaceItem->mapRectToScene(surfaceItem->boundingRect()) != bounds)
+        return nullptr;
+    if (m_glassPane && paintsInside(m_glassPane, bounds))
+        return nullptr;
+    return top;
+}
+
+// whether any visible item in the subtree draws something on screen
+bool FullscreenBypass::paintsInside(QQuickItem *item, const QRectF &bounds) const
+{
+    if (!item->isVisible() || qFuzzyIsNull(item->opacity()))
+        return false;
+    if ((item->flags() & QQuickItem::ItemHasContents) &&
+            item->mapRectToScene(item->boundingRect()).intersects(bounds))
+        return true;
+    const QList<QQuickItem *> children = item->childItems();
+    for (QQuickItem *child : children)
+        if (paintsInside(child, bounds))
+            return true;
+    return false;
+}
+
+void FullscreenBypass::apply(QQuickItem *view)
+{
+    const bool changed = view != m_view || m_active != (view != nullptr);
+    if (!changed && !view)
+        return;
+    if (changed)
+        qCDebug(lcBypass) << m_window << (view ? "bypassing composition for" : "composing normally") << view;
+    m_view = view;
+    m_active = view;
+    if (m_background)
+        m_background->setVisible(!view);
+    // also views that appeared since the last frame
+    if (m_surfaceArea) {
+        const QList<QQuickItem *> views = m_surfaceArea->childItems();
+        for (QQuickItem *v : views) {
+            const bool hide = view && v != view;
+            if (v->property(BypassHiddenProperty).toBool() != hide)
+                v->setProperty(BypassHiddenProperty, hide);
+        }
+    }
+    if (changed)
+        emit activeChanged();
+}
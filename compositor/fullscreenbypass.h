@@ -0,0 +1,70 @@
+#ifndef FULLSCREENBYPASS_H
+#define FULLSCREENBYPASS_H
+
+#include <QPointer>
+#include <QQuickItem>
+#include <QQuickWindow>
+
+/*!
+    Reduces an output to a single fullscreen window when nothing else could
+    be seen anyway: if the topmost view in \c surfaceArea is fullscreen,
+    opaque (the item, and the client's surface according to its opaque
+    region) and covers the window exactly, and nothing in \c glassPane
+    paints onto the screen, the background is hidden and the other views
+    get their \c bypassHidden property set. The scene graph then draws one
+    textured quad per frame instead of composing everything underneath.
+
+    The conditions are checked after each animation step, so that the
+    bypass ends on the same frame on which, say, a slide panel starts to
+    appear.
+*/
+class FullscreenBypass : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(QQuickWindow *window READ window WRITE setWindow NOTIFY windowChanged)
+    Q_PROPERTY(QQuickItem *surfaceArea READ surfaceArea WRITE setSurfaceArea NOTIFY surfaceAreaChanged)
+    Q_PROPERTY(QQuickItem *background MEMBER m_background NOTIFY backgroundChanged)
+    Q_PROPERTY(QQuickItem *glassPane MEMBER m_glassPane NOTIFY glassPaneChanged)
+    Q_PROPERTY(bool enabled READ isEnabled WRITE setEnabled NOTIFY enabledChanged)
+    Q_PROPERTY(bool active READ isActive NOTIFY activeChanged)
+    Q_PROPERTY(QQuickItem *view READ view NOTIFY activeChanged)
+
+public:
+    explicit FullscreenBypass(QObject *parent = nullptr);
+
+    QQuickWindow *window() const { return m_window; }
+    void setWindow(QQuickWindow *window);
+    QQuickItem *surfaceArea() const { return m_surfaceArea; }
+    void setSurfaceArea(QQuickItem *surfaceArea);
+    bool isEnabled() const { return m_enabled; }
+    void setEnabled(bool enabled);
+    bool isActive() const { return m_active; }
+    QQuickItem *view() const { return m_view; }
+
+signals:
+    void windowChanged();
+    void surfaceAreaChanged();
+    void backgroundChanged();
+    void glassPaneChanged();
+    void enabledChanged();
+    void activeChanged();
+
+public slots:
+    void update();
+
+protected:
+    QQuickItem *fullscreenView() const;
+    bool paintsInside(QQuickItem *item, const QRectF &bounds) const;
+    void apply(QQuickItem *view);
+
+protected:
+    QPointer<QQuickWindow> m_window;
+    QPointer<QQuickItem> m_surfaceArea;
+    QPointer<QQuickItem> m_background;
+    QPointer<QQuickItem> m_glassPane;
+    QPointer<QQuickItem> m_view;
+    bool m_enabled = true;
+    bool m_active = false;
+};
+
+#endif // FULLSCREENBYPASS_H
@@ -0,0 +1,137 @@
+#include "headlessdriver.h"
+#include "stackingmanager.h"
+#include "surfaceviewtracker.h"
+#include "workspacemanager.h"
+
+#include <QCoreApplication>
+#include <QQuickItem>
+#include <QQuickWindow>
+#include <memory>
+
+#include <stdio.h>
+#include <unistd.h>
+
+HeadlessDriver::HeadlessDriver(QObject *root, QObject *parent)
+    : QObject(parent)
+    , m_root(root)
+    , m_workspaceManager(root->findChild<WorkspaceManager *>())
+    , m_stdin(STDIN_FILENO, QSocketNotifier::Read)
+{
+    connect(&m_stdin, &QSocketNotifier::activated, this, &HeadlessDriver::readCommand);
+}
+
+void HeadlessDriver::readCommand()
+{
+    char buf[256];
+    const ssize_t n = read(STDIN_FILENO, buf, sizeof(buf));
+    if (n <= 0) {
+        // the benchmark went away
+        m_stdin.setEnabled(false);
+        return;
+    }
+    m_buffer.append(buf, int(n));
+    int newline;
+    while (!m_busy && (newline = m_buffer.indexOf('\n')) >= 0) {
+        const QByteArray line = m_buffer.left(newline).trimmed();
+        m_buffer.remove(0, newline + 1);
+        if (!line.isEmpty())
+            command(line);
+    }
+}
+
+void HeadlessDriver::reply(const QByteArray &line)
+{
+    fprintf(stdout, "%s\n", line.constData());
+    fflush(stdout);
+    m_busy = false;
+    // commands that arrived in the meantime
+    if (m_buffer.contains('\n'))
+        QMetaObject::invokeMethod(this, &HeadlessDriver::readCommand, Qt::QueuedConnection);
+}
+
+QList<QQuickWindow *> HeadlessDriver::windows() const
+{
+    return m_root ? m_root->findChildren<QQuickWindow *>() : QList<QQuickWindow *>();
+}
+
+StackingManager *HeadlessDriver::stackingManager() const
+{
+    return m_workspaceManager ? m_workspaceManager->currentStackingManager() : nullptr;
+}
+
+// calls then() once every output has swapped a new frame
+void HeadlessDriver::renderFrame(const std::function<void()> &then)
+{
+    const QList<QQuickWindow *> windows = this->windows();
+    auto pending = std::make_shared<int>(windows.count());
+    for (QQuickWindow *window : windows) {
+        connect(window, &QQuickWindow::frameSwapped, this, [pending, then]() {
+            if (--*pending == 0)
+                then();
+        }, Qt::ConnectionType(Qt::QueuedConnection | Qt::SingleShotConnection));
+        window->update();
+    }
+    if (windows.isEmpty())
+        then();
+}
+
+void HeadlessDriver::command(const QByteArray &line)
+{
+    const QList<QByteArray> args = line.split(' ');
+    const QByteArray &cmd = args.first();
+    const int count = qMax(1, args.value(1).toInt());
+    m_busy = true;
+    if (cmd == "windows") {
+        reply("windows " + QByteArray::number(stackingManager() ? stackingManager()->count() : 0));
+    } else if (cmd == "raise") {
+        m_timer.start();
+        raiseRound(0, count, 0, 0);
+    } else if (cmd == "move") {
+        m_timer.start();
+        moveStep(0, count);
+    } else if (cmd == "quit") {
+        reply("quit");
+        QCoreApplication::quit();
+    } else {
+        reply("error unknown command " + cmd);
+    }
+}
+
+void HeadlessDriver::raiseRound(int round, int rounds, qint64 raiseNs, int raises)
+{
+    StackingManager *stack = stackingManager();
+    if (round == rounds || !stack) {
+        const qreal usPerRaise = raises ? raiseNs / 1000.0 / raises : 0;
+        const qreal msPerFrame = m_timer.nsecsElapsed() / 1000000.0 / qMax(1, rounds);
+        reply("raise " + QByteArray::number(raises) + ' ' + QByteArray::number(usPerRaise, 'f', 3) + ' ' +
+              QByteArray::number(msPerFrame, 'f', 3));
+        return;
+    }
+    // the bottom one each time: every raise changes the order
+    QElapsedTimer timer;
+    timer.start();
+    const int count = stack->count();
+    for (int i = 0; i < count; ++i)
+        stack->raise(stack->bottomWindow());
+    raiseNs += timer.nsecsElapsed();
+    raises += count;
+    renderFrame([=]() { raiseRound(round + 1, rounds, raiseNs, raises); });
+}
+
+void HeadlessDriver::moveStep(int step, int steps)
+{
+    StackingManager *stack = stackingManager();
+    if (step == steps || !stack) {
+        reply("move " + QByteArray::number(steps) + ' ' +
+              QByteArray::number(m_timer.nsecsElapsed() / 1000000.0 / qMax(1, steps), 'f', 3));
+        return;
+    }
+    const qreal delta = step % 2 ? -1 : 1;
+    const QList<QObject *> windows = stack->windows();
+    for (QObject *shellSurface : windows) {
+        SurfaceViewTracker *tracker = SurfaceViewTracker::trackerFor(shellSurface->property("surface").value<QObject *>());
+        if (QQuickItem *moveItem = tracker ? tracker->moveItem() : nullptr)
+            moveItem->setPosition(moveItem->position() + QPointF(delta, delta));
+    }
+    renderFrame([=]() { moveStep(step + 1, steps); });
+}
@@ -0,0 +1,55 @@
+#ifndef HEADLESSDRIVER_H
+#define HEADLESSDRIVER_H
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QPointer>
+#include <QSocketNotifier>
+#include <functional>
+
+class QQuickWindow;
+class StackingManager;
+class WorkspaceManager;
+
+/*!
+    With --headless, reads commands from stdin, one per line, and replies on
+    stdout, so that a benchmark (see benchmark/) can measure what a
+    synthetic client cannot do itself, since it would need pointer input:
+
+    \list
+    \li \c{windows}: replies \c{windows <count>}, on the current workspace
+    \li \c{raise <rounds>}: raises each window in turn, from the bottom,
+        and renders a frame on every output after each round; replies
+        \c{raise <raises> <µs per raise> <ms per frame>}
+    \li \c{move <steps>}: moves all windows by a pixel and renders a frame,
+        that many times; replies \c{move <steps> <ms per frame>}
+    \li \c{quit}
+    \endlist
+*/
+class HeadlessDriver : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit HeadlessDriver(QObject *root, QObject *parent = nullptr);
+
+protected:
+    void readCommand();
+    void command(const QByteArray &line);
+    void reply(const QByteArray &line);
+    QList<QQuickWindow *> windows() const;
+    StackingManager *stackingManager() const;
+    void renderFrame(const std::function<void()> &then);
+    void raiseRound(int round, int rounds, qint64 raiseNs, int raises);
+    void moveStep(int step, int steps);
+
+protected:
+    QPointer<QObject> m_root;
+    QPointer<WorkspaceManager> m_workspaceManager;
+    QSocketNotifier m_stdin;
+    QByteArray m_buffer;
+    QElapsedTimer m_timer;
+    bool m_busy = false;
+};
+
+#endif // HEADLESSDRIVER_H
@@ -0,0 +1,152 @@
+#include "inputcoalescer.h"
+
+#include <QCoreApplication>
+#include <QLoggingCategory>
+#include <QMouseEvent>
+#include <QQuickWindow>
+
+Q_LOGGING_CATEGORY(lcInput, "grefsen.compositor.input")
+
+static const int StatsInterval = 500; // ms
+
+InputCoalescer::InputCoalescer(QQuickItem *parent)
+    : QQuickItem(parent)
+{
+    m_clock.start();
+    m_statsTimer.setInterval(StatsInterval);
+    connect(&m_statsTimer, &QTimer::timeout, this, &InputCoalescer::publishStats);
+    m_statsTimer.start();
+}
+
+InputCoalescer::~InputCoalescer()
+{
+    setWindow(nullptr);
+}
+
+void InputCoalescer::setCoalescing(bool coalescing)
+{
+    if (m_coalescing == coalescing)
+        return;
+    m_coalescing = coalescing;
+    if (!coalescing)
+        deliverPendingMove();
+    emit coalescingChanged();
+}
+
+void InputCoalescer::itemChange(ItemChange change, const ItemChangeData &value)
+{
+    if (change == ItemSceneChange)
+        setWindow(value.window);
+    QQuickItem::itemChange(change, value);
+}
+
+void InputCoalescer::setWindow(QQuickWindow *window)
+{
+    if (m_window == window)
+        return;
+    if (m_window) {
+        m_window->removeEventFilter(this);
+        disconnect(m_window, nullptr, this, nullptr);
+    }
+    m_pendingMove.reset();
+    m_window = window;
+    if (window) {
+        window->installEventFilter(this);
+        // on the render thread, while the GUI thread is blocked
+        connect(window, &QQuickWindow::beforeSynchronizing, this, &InputCoalescer::beforeSynchronizing, Qt::DirectConnection);
+        connect(window, &QQuickWindow::frameSwapped, this, &InputCoalescer::frameSwapped, Qt::DirectConnection);
+    }
+}
+
+void InputCoalescer::arrived(qint64 when)
+{
+    m_events.fetch_add(1, std::memory_order_relaxed);
+    if (m_frameInput < 0)
+        m_frameInput = when;
+}
+
+bool InputCoalescer::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched != m_window || m_delivering)
+        return false;
+    switch (event->type()) {
+    case QEvent::MouseMove:
+        arrived(m_clock.nsecsElapsed());
+        if (!m_coalescing)
+            return false;
+        if (m_pendingMove)
+            m_coalesced.fetch_add(1, std::memory_order_relaxed);
+        m_pendingMove.reset(static_cast<QMouseEvent *>(event->clone()));
+        polish();
+        return true;
+    case QEvent::MouseButtonPress:
+    case QEvent::MouseButtonRelease:
+    case QEvent::MouseButtonDblClick:
+    case QEvent::Wheel:
+    case QEvent::Leave:
+        deliverPendingMove();
+        arrived(m_clock.nsecsElapsed());
+        return false;
+    case QEvent::TouchBegin:
+    case QEvent::TouchUpdate:
+    case QEvent::TouchEnd:
+        arrived(m_clock.nsecsElapsed());
+        return false;
+    default:
+        return false;
+    }
+}
+
+// Qt Quick polishes until no more items need it, so a WindowDecoration
+// that resizes in response to the move still gets polished for this frame
+void InputCoalescer::updatePolish()
+{
+    deliverPendingMove();
+}
+
+void InputCoalescer::deliverPendingMove()
+{
+    if (!m_pendingMove || !m_window)
+        return;
+    std::unique_ptr<QMouseEvent> move = std::move(m_pendingMove);
+    m_delivering = true;
+    QCoreApplication::sendEvent(m_window, move.get());
+    m_delivering = false;
+}
+
+void InputCoalescer::beforeSynchronizing()
+{
+    m_renderedInput = m_frameInput;
+    m_frameInput = -1;
+}
+
+void InputCoalescer::frameSwapped()
+{
+    if (m_renderedInput < 0)
+        return;
+    const qint64 latency = m_clock.nsecsElapsed() - m_renderedInput;
+    m_renderedInput = -1;
+    m_latencySum.fetch_add(latency, std::memory_order_relaxed);
+    m_latencyCount.fetch_add(1, std::memory_order_relaxed);
+    qint64 max = m_latencyMax.load(std::memory_order_relaxed);
+    while (latency > max && !m_latencyMax.compare_exchange_weak(max, latency, std::memory_order_relaxed))
+        ;
+}
+
+void InputCoalescer::publishStats()
+{
+    const int events = m_events.exchange(0, std::memory_order_relaxed);
+    const int coalesced = m_coalesced.exchange(0, std::memory_order_relaxed);
+    const qint64 latencySum = m_latencySum.exchange(0, std::memory_order_relaxed);
+    const int latencyCount = m_latencyCount.exchange(0, std::memory_order_relaxed);
+    const qint64 latencyMax = m_latencyMax.exchange(0, std::memory_order_relaxed);
+    const qreal perSecond = 1000.0 / StatsInterval;
+    m_eventsPerSecond = qRound(events * perSecond);
+    m_coalescedPerSecond = qRound(coalesced * perSecond);
+    m_averageLatency = latencyCount ? latencySum / 1000000.0 / latencyCount : 0;
+    m_maxLatency = latencyMax / 1000000.0;
+    if (events)
+        qCDebug(lcInput) << m_window << m_eventsPerSecond << "events/s," << m_coalescedPerSecond << "coalesced; latency"
+                         << m_averageLatency << "ms, worst" << m_maxLatency;
+    emit statsChanged();
+}
@@ -0,0 +1,89 @@
+#ifndef INPUTCOALESCER_H
+#define INPUTCOALESCER_H
+
+#include <QElapsedTimer>
+#include <QPointer>
+#include <QQuickItem>
+#include <QTimer>
+#include <atomic>
+#include <memory>
+
+class QMouseEvent;
+
+/*!
+    Coalesces mouse motion on an output window: a 1000 Hz mouse would
+    otherwise run every DragHandler, HoverHandler, binding and Wayland
+    pointer motion event a dozen times per frame. Each move is held until
+    the window is polished before the next frame, and only the latest one is
+    delivered; a press, release or wheel event delivers the held move first,
+    to keep the order. (Qt Quick already compresses touch updates to one per
+    frame in the same way.)
+
+    It also measures the input latency, from the arrival of an event to the
+    swap of the frame that shows its effect; the statistics are updated
+    twice a second.
+
+    Put it anywhere in the window; it has no size and draws nothing.
+*/
+class InputCoalescer : public QQuickItem
+{
+    Q_OBJECT
+    Q_PROPERTY(bool coalescing READ isCoalescing WRITE setCoalescing NOTIFY coalescingChanged)
+    Q_PROPERTY(int eventsPerSecond READ eventsPerSecond NOTIFY statsChanged)
+    Q_PROPERTY(int coalescedPerSecond READ coalescedPerSecond NOTIFY statsChanged)
+    Q_PROPERTY(qreal averageLatency READ averageLatency NOTIFY statsChanged)
+    Q_PROPERTY(qreal maxLatency READ maxLatency NOTIFY statsChanged)
+
+public:
+    explicit InputCoalescer(QQuickItem *parent = nullptr);
+    ~InputCoalescer() override;
+
+    bool isCoalescing() const { return m_coalescing; }
+    void setCoalescing(bool coalescing);
+    int eventsPerSecond() const { return m_eventsPerSecond; }
+    int coalescedPerSecond() const { return m_coalescedPerSecond; }
+    qreal averageLatency() const { return m_averageLatency; }
+    qreal maxLatency() const { return m_maxLatency; }
+
+signals:
+    void coalescingChanged();
+    void statsChanged();
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+    void itemChange(ItemChange change, const ItemChangeData &value) override;
+    void updatePolish() override;
+
+    void setWindow(QQuickWindow *window);
+    void deliverPendingMove();
+    void arrived(qint64 when);
+    void beforeSynchronizing();
+    void frameSwapped();
+    void publishStats();
+
+protected:
+    QPointer<QQuickWindow> m_window;
+    std::unique_ptr<QMouseEvent> m_pendingMove;
+    QElapsedTimer m_clock;
+    QTimer m_statsTimer;
+    bool m_coalescing = true;
+    bool m_delivering = false;
+
+    // GUI thread: the earliest arrival of the input delivered for the next frame
+    qint64 m_frameInput = -1;
+    // render thread: the same, for the frame being rendered
+    qint64 m_renderedInput = -1;
+
+    std::atomic<int> m_events{0};
+    std::atomic<int> m_coalesced{0};
+    std::atomic<qint64> m_latencySum{0}; // ns
+    std::atomic<qint64> m_latencyMax{0};
+    std::atomic<int> m_latencyCount{0};
+
+    int m_eventsPerSecond = 0;
+    int m_coalescedPerSecond = 0;
+    qreal m_averageLatency = 0; // ms
+    qreal m_maxLatency = 0;
+};
+
+#endif // INPUTCOALESCER_H
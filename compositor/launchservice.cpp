@@ -0,0 +1,118 @@
+#include "launchservice.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QLoggingCategory>
+#include <QProcess>
+#include <QRegularExpression>
+#include <QSet>
+#include <QStandardPaths>
+#include <QThreadPool>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+Q_LOGGING_CATEGORY(lcLaunch, "grefsen.compositor.launch")
+
+LaunchService *LaunchService::s_instance = nullptr;
+
+LaunchService::LaunchService(QObject *parent)
+    : QObject(parent)
+{
+    Q_ASSERT(!s_instance);
+    s_instance = this;
+}
+
+LaunchService::~LaunchService()
+{
+    s_instance = nullptr;
+}
+
+QProcessEnvironment LaunchService::environment()
+{
+    // main() has set up WAYLAND_DISPLAY, QT_QPA_PLATFORM etc. before anything is launched
+    if (!m_environmentCached) {
+        m_environment = QProcessEnvironment::systemEnvironment();
+        m_environmentCached = true;
+    }
+    return m_environment;
+}
+
+qint64 LaunchService::launch(const QString &program, const QStringList &arguments, const QString &workingDirectory)
+{
+    QElapsedTimer timer;
+    timer.start();
+    QProcess process;
+    process.setProgram(program);
+    process.setArguments(arguments);
+    process.setProcessEnvironment(environment());
+    if (!workingDirectory.isEmpty())
+        process.setWorkingDirectory(workingDirectory);
+    qint64 pid = -1;
+    if (!process.startDetached(&pid)) {
+        qWarning() << "failed to launch" << program << arguments << process.errorString();
+        emit launchFailed(program, process.errorString());
+        return -1;
+    }
+    qCDebug(lcLaunch) << "launched" << program << arguments << "pid" << pid << "in" << timer.nsecsElapsed() / 1000 << "us";
+    emit launched(pid, program);
+    return pid;
+}
+
+// the libraries that the dynamic linker would load, as reported by ldd
+static QStringList linkedLibraries(const QString &executable)
+{
+    QProcess ldd;
+    ldd.start(QStringLiteral("ldd"), QStringList() << executable);
+    if (!ldd.waitForFinished(5000))
+        return QStringList();
+    static const QRegularExpression pathRe(QStringLiteral("(?:=> )?(/\\S+) \\(0x"));
+    QStringList ret;
+    const QStringList lines = QString::fromLocal8Bit(ldd.readAllStandardOutput()).split(QLatin1Char('\n'));
+    for (const QString &line : lines) {
+        QRegularExpressionMatch match = pathRe.match(line);
+        if (match.hasMatch())
+            ret << match.captured(1);
+    }
+    return ret;
+}
+
+void LaunchService::prewarm(const QStringList &programs)
+{
+    QStringList executables;
+    for (const QString &program : programs) {
+        QString executable = QStandardPaths::findExecutable(program.trimmed());
+        if (executable.isEmpty())
+            qCDebug(lcLaunch) << "not prewarming" << program << ": not found";
+        else
+            executables << executable;
+    }
+    if (executables.isEmpty())
+        return;
+
+    QThreadPool::globalInstance()->start([executables]() {
+        QElapsedTimer timer;
+        timer.start();
+        QSet<QString> files;
+        for (const QString &executable : executables) {
+            files.insert(executable);
+            const QStringList libraries = linkedLibraries(executable);
+            for (const QString &library : libraries)
+                files.insert(library);
+        }
+        // the kernel reads ahead asynchronously; what is already cached costs nothing
+        qint64 bytes = 0;
+        for (const QString &file : qAsConst(files)) {
+            int fd = open(QFile::encodeName(file).constData(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+                continue;
+            struct stat st;
+            if (fstat(fd, &st) == 0 && posix_fadvise(fd, 0, st.st_size, POSIX_FADV_WILLNEED) == 0)
+                bytes += st.st_size;
+            close(fd);
+        }
+        qCDebug(lcLaunch) << "prewarming" << executables << ":" << files.count() << "files," << bytes / 1024 << "KiB in"
+                          << timer.elapsed() << "ms";
+    });
+}
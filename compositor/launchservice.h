@@ -0,0 +1,52 @@
+#ifndef LAUNCHSERVICE_H
+#define LAUNCHSERVICE_H
+
+#include <QObject>
+#include <QProcessEnvironment>
+#include <QStringList>
+
+/*!
+    Starts applications for everything in Grefsen that launches them: the
+    ProcessLauncher QML type, and (through the "launchService" property of
+    qApp, since it's in a separate plugin) the LauncherModel in the Grefsen
+    module. The processes are detached, so that they outlive a compositor
+    restarted by the supervisor, and their environment is built only once.
+
+    prewarm() reads the executables of frequently used applications, and
+    the libraries they link, into the page cache in the background, so that
+    launching one of them soon after the session starts is not slowed down
+    by disk I/O. The applications are set in grefsen.conf:
+
+    \code
+    [launch]
+    prewarm=konsole, qtcreator
+    \endcode
+*/
+class LaunchService : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit LaunchService(QObject *parent = nullptr);
+    ~LaunchService() override;
+
+    static LaunchService *instance() { return s_instance; }
+
+    QProcessEnvironment environment();
+
+    // returns the pid, or -1 on failure
+    Q_INVOKABLE qint64 launch(const QString &program, const QStringList &arguments,
+                              const QString &workingDirectory = QString());
+    void prewarm(const QStringList &programs);
+
+signals:
+    void launched(qint64 pid, const QString &program);
+    void launchFailed(const QString &program, const QString &errorString);
+
+protected:
+    static LaunchService *s_instance;
+    QProcessEnvironment m_environment;
+    bool m_environmentCached = false;
+};
+
+#endif // LAUNCHSERVICE_H
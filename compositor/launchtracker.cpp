@@ -0,0 +1,215 @@
+#include "launchtracker.h"
+
+#include <QFile>
+#include <QLoggingCategory>
+#include <QQuickWindow>
+#include <QSettings>
+#include <QtWaylandCompositor/QWaylandClient>
+#include <QtWaylandCompositor/QWaylandCompositor>
+#include <QtWaylandCompositor/QWaylandOutput>
+#include <QtWaylandCompositor/QWaylandSurface>
+#include <algorithm>
+
+Q_LOGGING_CATEGORY(lcLaunchTimes, "grefsen.compositor.launchtimes")
+
+static const QString LaunchTimesGroup = QStringLiteral("launchTimes");
+static const int RecentCount = 50;
+static const int MaxAncestors = 4; // a launcher script may fork the real application
+static const qint64 LaunchTimeout = 60; // s; give up on apps that never show a window
+static const int ExpiryInterval = 10000; // ms
+
+static qint64 parentPid(qint64 pid)
+{
+    QFile stat(QStringLiteral("/proc/%1/stat").arg(pid));
+    if (!stat.open(QIODevice::ReadOnly))
+        return 0;
+    // pid (comm) state ppid ...; comm may contain spaces and parentheses
+    const QByteArray line = stat.readAll();
+    const int end = line.lastIndexOf(')');
+    if (end < 0)
+        return 0;
+    const QList<QByteArray> fields = line.mid(end + 2).split(' ');
+    return fields.count() > 1 ? fields.at(1).toLongLong() : 0;
+}
+
+static qreal ms(qint64 ns)
+{
+    return ns / 1000000.0;
+}
+
+LaunchTracker::LaunchTracker(QObject *parent)
+    : QObject(parent)
+{
+    m_clock.start();
+    m_expiryTimer.setInterval(ExpiryInterval);
+    connect(&m_expiryTimer, &QTimer::timeout, this, &LaunchTracker::expire);
+}
+
+void LaunchTracker::setCompositor(QWaylandCompositor *compositor)
+{
+    if (m_compositor == compositor)
+        return;
+    if (m_compositor)
+        disconnect(m_compositor, nullptr, this, nullptr);
+    m_compositor = compositor;
+    if (compositor)
+        connect(compositor, &QWaylandCompositor::surfaceCreated, this, &LaunchTracker::surfaceCreated);
+}
+
+void LaunchTracker::trackLaunch(qint64 pid, const QString &program)
+{
+    if (pid <= 0)
+        return;
+    Launch launch;
+    launch.pid = pid;
+    launch.program = program.section(QLatin1Char('/'), -1);
+    launch.spawned = m_clock.nsecsElapsed();
+    m_pending.insert(pid, launch);
+    m_expiryTimer.start();
+    emit statsChanged();
+}
+
+QHash<qint64, LaunchTracker::Launch>::iterator LaunchTracker::findLaunch(qint64 clientPid)
+{
+    qint64 pid = clientPid;
+    for (int i = 0; pid > 1 && i <= MaxAncestors; ++i) {
+        auto it = m_pending.find(pid);
+        if (it != m_pending.end())
+            return it;
+        pid = parentPid(pid);
+    }
+    return m_pending.end();
+}
+
+void LaunchTracker::surfaceCreated(QWaylandSurface *surface)
+{
+    if (m_pending.isEmpty() || !surface->client())
+        return;
+    auto it = findLaunch(surface->client()->processId());
+    if (it == m_pending.end() || it->surface)
+        return;
+    it->connected = m_clock.nsecsElapsed();
+    it->surface = surface;
+    connect(surface, &QWaylandSurface::hasContentChanged, this, [this, surface]() { contentChanged(surface); });
+}
+
+void LaunchTracker::contentChanged(QWaylandSurface *surface)
+{
+    if (!surface->hasContent())
+        return;
+    auto it = std::find_if(m_pending.begin(), m_pending.end(), [surface](const Launch &l) { return l.surface == surface; });
+    if (it == m_pending.end() || it->committed >= 0)
+        return;
+    it->committed = m_clock.nsecsElapsed();
+    disconnect(surface, nullptr, this, nullptr);
+
+    // whichever output gets there first; frameSwapped comes from the render thread
+    const qint64 pid = it->pid;
+    const QList<QWaylandOutput *> outputs = m_compositor ? m_compositor->outputs() : QList<QWaylandOutput *>();
+    for (QWaylandOutput *output : outputs) {
+        QQuickWindow *window = qobject_cast<QQuickWindow *>(output->window());
+        if (!window)
+            continue;
+        connect(window, &QQuickWindow::frameSwapped, this, [this, pid]() {
+            const qint64 when = m_clock.nsecsElapsed();
+            QMetaObject::invokeMethod(this, [this, pid, when]() { presented(pid, when); }, Qt::QueuedConnection);
+        }, Qt::ConnectionType(Qt::DirectConnection | Qt::SingleShotConnection));
+    }
+}
+
+void LaunchTracker::presented(qint64 pid, qint64 when)
+{
+    auto it = m_pending.find(pid);
+    if (it == m_pending.end() || it->committed < 0)
+        return;
+    Launch launch = *it;
+    m_pending.erase(it);
+    launch.presented = when;
+    complete(launch);
+}
+
+void LaunchTracker::complete(const Launch &launch)
+{
+    const qreal total = ms(launch.presented - launch.spawned);
+    qCInfo(lcLaunchTimes, "%s (pid %lld): connected %.1f ms, first commit +%.1f ms, first frame +%.1f ms: %.1f ms",
+           qPrintable(launch.program), launch.pid, ms(launch.connected - launch.spawned),
+           ms(launch.committed - launch.connected), ms(launch.presented - launch.committed), total);
+
+    m_recent.append(launch);
+    if (m_recent.count() > RecentCount)
+        m_recent.removeFirst();
+
+    QSettings settings;
+    settings.beginGroup(LaunchTimesGroup);
+    settings.beginGroup(launch.program);
+    const int count = settings.value(QStringLiteral("count")).toInt();
+    const qreal average = settings.value(QStringLiteral("averageMs")).toReal();
+    settings.setValue(QStringLiteral("count"), count + 1);
+    settings.setValue(QStringLiteral("averageMs"), qRound((average * count + total) / (count + 1)));
+    settings.setValue(QStringLiteral("lastMs"), qRound(total));
+
+    emit launchCompleted(launch.program, total);
+    emit statsChanged();
+}
+
+void LaunchTracker::expire()
+{
+    const qint64 now = m_clock.nsecsElapsed();
+    for (auto it = m_pending.begin(); it != m_pending.end(); ) {
+        if (now - it->spawned > LaunchTimeout * 1000000000) {
+            qCDebug(lcLaunchTimes) << it->program << "pid" << it->pid << "did not show a window within" << LaunchTimeout << "s";
+            it = m_pending.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    if (m_pending.isEmpty())
+        m_expiryTimer.stop();
+    emit statsChanged();
+}
+
+QVariantList LaunchTracker::recentLaunches() const
+{
+    QVariantList ret;
+    for (const Launch &launch : m_recent) {
+        QVariantMap m;
+        m.insert(QStringLiteral("program"), launch.program);
+        m.insert(QStringLiteral("pid"), launch.pid);
+        m.insert(QStringLiteral("connectMs"), ms(launch.connected - launch.spawned));
+        m.insert(QStringLiteral("commitMs"), ms(launch.committed - launch.spawned));
+        m.insert(QStringLiteral("frameMs"), ms(launch.presented - launch.spawned));
+        ret << m;
+    }
+    return ret;
+}
+
+QVariantMap LaunchTracker::statsFor(const QString &program) const
+{
+    QSettings settings;
+    settings.beginGroup(LaunchTimesGroup);
+    settings.beginGroup(program.section(QLatin1Char('/'), -1));
+    QVariantMap ret;
+    const QStringList keys = settings.childKeys();
+    for (const QString &key : keys)
+        ret.insert(key, settings.value(key).toInt());
+    return ret;
+}
+
+QStringList LaunchTracker::slowestPrograms(int count) const
+{
+    QSettings settings;
+    settings.beginGroup(LaunchTimesGroup);
+    QVector<QPair<qint64, QString>> costs;
+    const QStringList programs = settings.childGroups();
+    for (const QString &program : programs) {
+        const qint64 launches = settings.value(program + QLatin1String("/count")).toLongLong();
+        costs << qMakePair(launches * settings.value(program + QLatin1String("/averageMs")).toLongLong(), program);
+    }
+    std::sort(costs.begin(), costs.end(), [](const QPair<qint64, QString> &a, const QPair<qint64, QString> &b) {
+        return a.first > b.first;
+    });
+    QStringList ret;
+    for (int i = 0; i < costs.count() && i < count; ++i)
+        ret << costs.at(i).second;
+    return ret;
+}
@@ -0,0 +1,81 @@
+#ifndef LAUNCHTRACKER_H
+#define LAUNCHTRACKER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+#include <QVariantList>
+#include <QVector>
+
+class QWaylandCompositor;
+class QWaylandSurface;
+
+/*!
+    Measures how long applications take to start: each process started by
+    LaunchService is followed from the moment it was spawned, to its first
+    surface (the client connecting; matched by the pid in the client's
+    credentials, or the pid of one of its parent processes, for launcher
+    scripts), to the first commit of a buffer, to the first frame presented
+    on an output after that.
+
+    Each completed launch is logged in the grefsen.compositor.launchtimes
+    category, and the running average per program is stored in the
+    launchTimes group of grefsen.conf, so that the programs for which
+    prewarming saves the most can be chosen automatically. The same stats are available in QML
+    via the launchTracker context property.
+*/
+class LaunchTracker : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(QVariantList recentLaunches READ recentLaunches NOTIFY statsChanged)
+    Q_PROPERTY(int pendingCount READ pendingCount NOTIFY statsChanged)
+
+public:
+    explicit LaunchTracker(QObject *parent = nullptr);
+
+    void setCompositor(QWaylandCompositor *compositor);
+
+    QVariantList recentLaunches() const;
+    int pendingCount() const { return m_pending.count(); }
+
+    // count, averageMs and lastMs (spawn to first frame) from grefsen.conf
+    Q_INVOKABLE QVariantMap statsFor(const QString &program) const;
+    // the programs for which prewarming would save the most: launched often, and slow
+    QStringList slowestPrograms(int count) const;
+
+signals:
+    void launchCompleted(const QString &program, qreal totalMs);
+    void statsChanged();
+
+public slots:
+    void trackLaunch(qint64 pid, const QString &program);
+
+protected:
+    struct Launch {
+        qint64 pid = 0;
+        QString program;
+        qint64 spawned = 0; // ns since m_clock started
+        qint64 connected = -1;
+        qint64 committed = -1;
+        qint64 presented = -1;
+        QPointer<QWaylandSurface> surface;
+    };
+
+    void surfaceCreated(QWaylandSurface *surface);
+    void contentChanged(QWaylandSurface *surface);
+    void presented(qint64 pid, qint64 when);
+    void complete(const Launch &launch);
+    void expire();
+    QHash<qint64, Launch>::iterator findLaunch(qint64 clientPid);
+
+protected:
+    QPointer<QWaylandCompositor> m_compositor;
+    QElapsedTimer m_clock;
+    QHash<qint64, Launch> m_pending; // by pid
+    QVector<Launch> m_recent;
+    QTimer m_expiryTimer;
+};
+
+#endif // LAUNCHTRACKER_H
@@ -20,19 +20,47 @@
 #include <QDebug>
 #include <QDir>
 #include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
 #include <QFontDatabase>
 #include <QGuiApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QScreen>
+#include <QSettings>
+#include <QTimer>
 #include <QUrl>
 #include <QWindow>
+#include <QtWaylandCompositor/QWaylandCompositor>
 
 #include <QtQml/qqml.h>
 #include <QQmlApplicationEngine>
 #include <QQmlContext>
 #include <QQuickItem>
+#include <QQuickWindow>
 
+#include "asynclogger.h"
+#include "damagetracker.h"
+#include "framepacer.h"
+#include "frameprofiler.h"
+#include "fullscreenbypass.h"
+#include "headlessdriver.h"
+#include "inputcoalescer.h"
+#include "launchservice.h"
+#include "launchtracker.h"
+#include "occlusionculler.h"
 #include "processlauncher.h"
+#include "sessionlayout.h"
 #include "stackableitem.h"
+#include "stackingmanager.h"
+#include "startuptimer.h"
+#include "supervisor.h"
+#include "surfaceviewtracker.h"
+#include "thumbnailcache.h"
+#include "windowdecoration.h"
+#include "windowswitcher.h"
+#include "workspacemanager.h"
 
 #include <errno.h>
 #include <signal.h>
@@ -43,11 +71,11 @@
 #include <unistd.h>
 
 static QLatin1String glassPaneName("glassPane");
-static QByteArray grefsonExecutablePath;
-static qint64 grefsonPID;
+static const int PrewarmDelay = 2000; // ms
 static void *signalHandlerStack;
 static QString logFilePath;
 static QElapsedTimer sinceStartup;
+static QString headlessConfigPath;
 
 QString grefsenConfigDirPath(QDir::homePath() + "/.config/grefsen/");
 
@@ -58,21 +86,11 @@ extern "C" void signalHandler(int signal)
     if (QX11Info::display())
         close(ConnectionNumber(QX11Info::display()));
 #endif
-    pid_t pid = fork();
-    switch (pid) {
-    case -1: // error
-        break;
-    case 0: // child
-        kill(grefsonPID, 9);
-        fprintf(stderr, "crashed (PID %lld SIG %d): respawn %s\n", grefsonPID, signal, grefsonExecutablePath.constData());
-        execl(grefsonExecutablePath.constData(), grefsonExecutablePath.constData(), (char *) 0);
-        _exit(EXIT_FAILURE);
-    default: // parent
-        prctl(PR_SET_PTRACER, pid, 0, 0, 0);
-        waitpid(pid, 0, 0);
-        _exit(EXIT_FAILURE);
-        break;
-    }
+    if (!logFilePath.isEmpty())
+        AsyncLogger::instance()->crashFlush();
+    // the handler has been reset to the default: die of the same signal, and the supervisor starts a new compositor
+    fprintf(stderr, "crashed (PID %lld SIG %d)\n", (long long)getpid(), signal);
+    raise(signal);
 }
 
 static void setupSignalHandler()
@@ -102,7 +120,7 @@ static void setupSignalHandler()
     // SA_RESETHAND - Restore signal action to default after signal handler has been called.
     // SA_NODEFER - Don't block the signal after it was triggered (otherwise blocked signals get
     // inherited via fork() and execve()). Without this the signal will not be delivered to the
-    // restarted Qt Creator.
+    // restarted compositor.
     // SA_ONSTACK - Use alternative stack.
     sa.sa_flags = SA_RESETHAND | SA_NODEFER | SA_ONSTACK;
     // See "man 7 signal" for an overview of signals.
@@ -115,44 +133,57 @@ static void setupSignalHandler()
 
 void qtMsgLog(QtMsgType type, const QMessageLogContext &context, const QString &msg)
 {
-    static QFile log(logFilePath);
-    if (!log.isOpen())
-        log.open(QIODevice::WriteOnly | QIODevice::Text);
-    char typeChar = ' ';
-    switch (type) {
-    case QtDebugMsg:
-        typeChar = 'd';
-        break;
-    case QtInfoMsg:
-        typeChar = 'i';
-        break;
-    case QtWarningMsg:
-        typeChar = 'W';
-        break;
-    case QtCriticalMsg:
-        typeChar = '!';
-        break;
-    case QtFatalMsg:
-        typeChar = 'F';
-    }
-    char buf[64];
-    qint64 ts = sinceStartup.elapsed();
-    snprintf(buf, 64, "[%6lld.%03lld %c] ", ts / 1000, ts % 1000, typeChar);
-    log.write(buf);
-    if (context.function) {
-        snprintf(buf, 64, "%s:%d: ", context.function, context.line);
-        log.write(buf);
-    }
-    log.write(msg.toUtf8());
-    log.write("\n");
-    if (type == QtFatalMsg)
+    AsyncLogger::instance()->log(type, context, msg);
+    if (type == QtFatalMsg) {
+        AsyncLogger::instance()->flush();
         abort();
+    }
+}
+
+static void startLogging()
+{
+    QSettings settings;
+    settings.beginGroup(QStringLiteral("log"));
+    AsyncLogger::Format format = settings.value(QStringLiteral("format")).toString() == QLatin1String("compact") ?
+                AsyncLogger::Compact : AsyncLogger::Text;
+    qint64 maxBytes = settings.value(QStringLiteral("maxSize"), 10).toLongLong() * 1024 * 1024;
+    int keepFiles = settings.value(QStringLiteral("files"), 3).toInt();
+    // without a log file, messages keep going to stderr
+    if (AsyncLogger::instance()->start(logFilePath, sinceStartup, format, maxBytes, keepFiles))
+        qInstallMessageHandler(qtMsgLog);
+    else
+        logFilePath.clear();
 }
 
 static void registerTypes()
 {
     qmlRegisterType<WaylandProcessLauncher>("com.theqtcompany.wlprocesslauncher", 1, 0, "ProcessLauncher");
+    qmlRegisterType<DamageTracker>("com.theqtcompany.wlcompositor", 1, 0, "DamageTracker");
+    qmlRegisterType<FramePacer>("com.theqtcompany.wlcompositor", 1, 0, "FramePacer");
+    qmlRegisterType<FrameProfiler>("com.theqtcompany.wlcompositor", 1, 0, "FrameProfiler");
+    qmlRegisterType<FullscreenBypass>("com.theqtcompany.wlcompositor", 1, 0, "FullscreenBypass");
+    qmlRegisterType<InputCoalescer>("com.theqtcompany.wlcompositor", 1, 0, "InputCoalescer");
+    qmlRegisterType<OcclusionCuller>("com.theqtcompany.wlcompositor", 1, 0, "OcclusionCuller");
+    qmlRegisterType<SessionLayout>("com.theqtcompany.wlcompositor", 1, 0, "SessionLayout");
     qmlRegisterType<StackableItem>("com.theqtcompany.wlcompositor", 1, 0, "StackableItem");
+    qmlRegisterType<StackingManager>("com.theqtcompany.wlcompositor", 1, 0, "StackingManager");
+    qmlRegisterType<SurfaceViewTracker>("com.theqtcompany.wlcompositor", 1, 0, "SurfaceViewTracker");
+    qmlRegisterType<WindowDecoration>("com.theqtcompany.wlcompositor", 1, 0, "WindowDecoration");
+    qmlRegisterType<WindowSwitcher>("com.theqtcompany.wlcompositor", 1, 0, "WindowSwitcher");
+    qmlRegisterType<WorkspaceManager>("com.theqtcompany.wlcompositor", 1, 0, "WorkspaceManager");
+}
+
+static void registerFonts()
+{
+    static bool registered = false;
+    if (registered)
+        return;
+    registered = true;
+    // no need to check QFontDatabase::families() first: populating it means scanning all the system fonts
+    if (QFontDatabase::addApplicationFont(":/fonts/FontAwesome.otf") < 0)
+        qWarning("failed to load FontAwesome from resources");
+    if (QFontDatabase::addApplicationFont(":/fonts/manzanit.pfb") < 0)
+        qWarning("failed to load Manzanita font from resources");
 }
 
 static qreal highestDPR(QList<QScreen *> &screens)
@@ -167,9 +198,68 @@ static qreal highestDPR(QList<QScreen *> &screens)
     return ret;
 }
 
+// --headless 1920x1080,1280x720: a virtual screen of each size, side by side, on the offscreen platform
+static bool setupHeadless(int argc, char *argv[])
+{
+    const char *sizes = nullptr;
+    for (int i = 1; i < argc - 1; ++i)
+        if (!strcmp(argv[i], "--headless"))
+            sizes = argv[i + 1];
+    if (!sizes)
+        return false;
+    QJsonArray screens;
+    int x = 0;
+    const QList<QByteArray> sizeList = QByteArray(sizes).split(',');
+    for (const QByteArray &size : sizeList) {
+        const QList<QByteArray> wh = size.split('x');
+        const int width = wh.value(0).toInt();
+        const int height = wh.value(1).toInt();
+        if (width <= 0 || height <= 0) {
+            fprintf(stderr, "invalid output size '%s': expected WIDTHxHEIGHT\n", size.constData());
+            continue;
+        }
+        QJsonObject screen;
+        screen.insert(QLatin1String("name"), QLatin1String("HEADLESS-") + QString::number(screens.count() + 1));
+        screen.insert(QLatin1String("x"), x);
+        screen.insert(QLatin1String("y"), 0);
+        screen.insert(QLatin1String("width"), width);
+        screen.insert(QLatin1String("height"), height);
+        screen.insert(QLatin1String("logicalDpi"), 96);
+        screen.insert(QLatin1String("logicalBaseDpi"), 96);
+        screen.insert(QLatin1String("dpr"), 1);
+        screens.append(screen);
+        x += width;
+    }
+    if (screens.isEmpty())
+        return false;
+    QJsonObject config;
+    config.insert(QLatin1String("windowFrameMargins"), false);
+    config.insert(QLatin1String("screens"), screens);
+    headlessConfigPath = QDir::tempPath() + QLatin1String("/grefsen-headless-") + QString::number(getpid()) + QLatin1String(".json");
+    QFile f(headlessConfigPath);
+    if (!f.open(QIODevice::WriteOnly)) {
+        fprintf(stderr, "failed to write %s\n", qPrintable(headlessConfigPath));
+        return false;
+    }
+    f.write(QJsonDocument(config).toJson());
+    qputenv("QT_QPA_PLATFORM", "offscreen:configfile=" + QFile::encodeName(headlessConfigPath));
+    return true;
+}
+
 int main(int argc, char *argv[])
 {
     sinceStartup.start();
+    // the supervisor must not initialize anything, so look for --respawn before QGuiApplication exists
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-r") || !strcmp(argv[i], "--respawn")) {
+            int ret = Supervisor::supervise();
+            if (ret >= 0)
+                return ret;
+            break;
+        }
+    }
+    // before QGuiApplication chooses the platform
+    const bool headless = setupHeadless(argc, argv);
     if (!qEnvironmentVariableIsSet("QT_XCB_GL_INTEGRATION"))
         qputenv("QT_XCB_GL_INTEGRATION", "xcb_egl"); // use xcomposite-glx if no EGL
     if (!qEnvironmentVariableIsSet("QT_WAYLAND_DISABLE_WINDOWDECORATION"))
@@ -178,14 +268,17 @@ int main(int argc, char *argv[])
         qputenv("QT_LABS_CONTROLS_STYLE", "Universal");
     if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORMTHEME"))
         qputenv("QT_QPA_PLATFORMTHEME", "generic");
+    // the default only on xcb: compresses motion that queued up while the GUI thread was busy
+    QCoreApplication::setAttribute(Qt::AA_CompressHighFrequencyEvents);
     QGuiApplication app(argc, argv);
+    StartupTimer startup(sinceStartup);
+    startup.mark(QStringLiteral("application created"));
     //QCoreApplication::setApplicationName("grefsen"); // defaults to name of the executable
     QCoreApplication::setOrganizationName("grefsen");
     QCoreApplication::setApplicationVersion("0.1");
 //    app.setAttribute(Qt::AA_DisableHighDpiScaling); // better use the env variable... but that's not enough on eglfs
-    grefsonExecutablePath = app.applicationFilePath().toLocal8Bit();
-    grefsonPID = QCoreApplication::applicationPid();
     bool windowed = false;
+    QString profilePath;
 
     QList<QScreen *> screens = QGuiApplication::screens();
     {
@@ -195,7 +288,7 @@ int main(int argc, char *argv[])
         parser.addVersionOption();
 
         QCommandLineOption respawnOption(QStringList() << "r" << "respawn",
-                QCoreApplication::translate("main", "respawn grefsen after a crash"));
+                QCoreApplication::translate("main", "run under a supervisor that restarts grefsen after a crash, keeping the Wayland socket and window layout"));
         parser.addOption(respawnOption);
 
         QCommandLineOption logFileOption(QStringList() << "l" << "log",
@@ -217,6 +310,23 @@ int main(int argc, char *argv[])
                 QCoreApplication::translate("main", "run in a window rather than fullscreen"));
         parser.addOption(windowOption);
 
+        QCommandLineOption profileOption(QStringList() << "p" << "profile",
+                QCoreApplication::translate("main", "write frame timing of each screen to a .csv or .json file on exit"),
+                QCoreApplication::translate("main", "file path"));
+        parser.addOption(profileOption);
+
+        QCommandLineOption headlessOption(QStringList() << "headless",
+                QCoreApplication::translate("main", "render in software to virtual outputs of the given sizes, without any real screens; "
+                                                    "read benchmark commands from stdin"),
+                QCoreApplication::translate("main", "WxH[,WxH...]"));
+        parser.addOption(headlessOption);
+
+        // handled by QWaylandCompositor itself
+        QCommandLineOption socketNameOption(QStringList() << "wayland-socket-name",
+                QCoreApplication::translate("main", "listen on the given socket in $XDG_RUNTIME_DIR rather than the next free wayland-N"),
+                QCoreApplication::translate("main", "name"));
+        parser.addOption(socketNameOption);
+
         parser.process(app);
         if (parser.isSet(respawnOption))
             setupSignalHandler();
@@ -224,7 +334,7 @@ int main(int argc, char *argv[])
             grefsenConfigDirPath = parser.value(configDirOption);
         if (parser.isSet(logFileOption)) {
             logFilePath = parser.value(logFileOption);
-            qInstallMessageHandler(qtMsgLog);
+            startLogging();
         }
         if (parser.isSet(screenOption)) {
             QStringList scrNames = parser.values(screenOption);
@@ -242,6 +352,8 @@ int main(int argc, char *argv[])
         }
         if (parser.isSet(windowOption))
             windowed = true;
+        if (parser.isSet(profileOption))
+            profilePath = parser.value(profileOption);
 
         qreal dpr = highestDPR(screens);
         if (!qEnvironmentVariableIsSet("XCURSOR_SIZE")) {
@@ -251,23 +363,45 @@ int main(int argc, char *argv[])
             qDebug() << "highest DPR" << dpr << "-> cursor size" << cursorSize;
             qputenv("XCURSOR_SIZE", QByteArray::number(cursorSize));
         }
-
-        QFontDatabase fd;
-        if (!fd.families().contains(QLatin1String("FontAwesome")))
-            if (QFontDatabase::addApplicationFont(":/fonts/FontAwesome.otf"))
-                qWarning("failed to load FontAwesome from resources");
-        if (!fd.families().contains(QLatin1String("Manzanita")))
-            if (QFontDatabase::addApplicationFont(":/fonts/manzanit.pfb"))
-                qWarning("failed to load Manzanita font from resources");
     }
+    startup.mark(QStringLiteral("arguments parsed"));
+
+    // the offscreen platform has no GPU to render with
+    if (headless)
+        QQuickWindow::setGraphicsApi(QSGRendererInterface::Software);
 
     registerTypes();
     qputenv("QT_QPA_PLATFORM", "wayland"); // not for grefsen but for child processes
 
+    if (Supervisor::hasSocket()) {
+        // clients, including those started before a crash, connect to the supervisor's socket
+        qputenv("WAYLAND_DISPLAY", Supervisor::socketName());
+        qputenv("QT_WAYLAND_RECONNECT", "1");
+    }
+
+    LaunchService launchService;
+    app.setProperty("launchService", QVariant::fromValue<QObject *>(&launchService));
+    LaunchTracker launchTracker;
+    QObject::connect(&launchService, &LaunchService::launched, &launchTracker, &LaunchTracker::trackLaunch);
+    ThumbnailCache thumbnailCache;
+
     QQmlApplicationEngine appEngine;
     appEngine.addImportPath(app.applicationDirPath() + QLatin1String("/imports"));
+    appEngine.addImageProvider(QStringLiteral("thumbnails"), thumbnailCache.imageProvider());
+    appEngine.rootContext()->setContextProperty(QStringLiteral("startupTimer"), &startup);
+    appEngine.rootContext()->setContextProperty(QStringLiteral("launchTracker"), &launchTracker);
+    appEngine.rootContext()->setContextProperty(QStringLiteral("thumbnailCache"), &thumbnailCache);
+    startup.mark(QStringLiteral("engine created"));
     appEngine.load(QUrl("qrc:///qml/main.qml"));
     QObject *root = appEngine.rootObjects().first();
+    startup.mark(QStringLiteral("main.qml loaded"));
+    launchTracker.setCompositor(qobject_cast<QWaylandCompositor *>(root));
+    if (Supervisor::isSupervised()) {
+        QWaylandCompositor *compositor = qobject_cast<QWaylandCompositor *>(root);
+        if (compositor && Supervisor::hasSocket())
+            compositor->addSocketDescriptor(Supervisor::socketFd());
+        Supervisor::notifyReady();
+    }
     root->setProperty("fullscreenAllowed", !windowed);
     appEngine.rootContext()->setContextProperty(glassPaneName,
         root->findChild<QQuickItem*>(glassPaneName));
@@ -278,7 +412,7 @@ int main(int argc, char *argv[])
         QWindow * window = *windowIter;
         QScreen * screen = *screenIter;
         window->setScreen(screen);
-        if (windowed) {
+        if (windowed && !headless) {
             window->resize(1920, 1080);
             window->showNormal();
         } else {
@@ -287,9 +421,59 @@ int main(int argc, char *argv[])
         }
         ++windowIter;
         ++screenIter;
-        if (windowed)
+        if (windowed && !headless)
             break;
     }
+    startup.mark(QStringLiteral("windows shown"));
+
+    // Staged bring-up: each output first shows its plain background; after that
+    // frame, the fonts are registered and Output.qml starts loading screen.qml.
+    for (QWindow *window : qAsConst(windows)) {
+        QQuickWindow *quickWindow = qobject_cast<QQuickWindow *>(window);
+        if (!quickWindow)
+            continue;
+        QObject::connect(quickWindow, &QQuickWindow::frameSwapped, quickWindow, [quickWindow, &startup]() {
+            startup.mark(QStringLiteral("first frame on ") + quickWindow->screen()->name());
+            registerFonts();
+            quickWindow->setProperty("firstFrameShown", true);
+        }, Qt::ConnectionType(Qt::QueuedConnection | Qt::SingleShotConnection));
+    }
+
+    {
+        // once the desktop is up, without competing with it for the disk
+        QSettings settings;
+        QStringList prewarm = settings.value(QStringLiteral("launch/prewarm")).toStringList();
+        const QStringList slowest = launchTracker.slowestPrograms(settings.value(QStringLiteral("launch/autoPrewarm"), 0).toInt());
+        for (const QString &program : slowest)
+            if (!prewarm.contains(program))
+                prewarm << program;
+        if (!prewarm.isEmpty())
+            QTimer::singleShot(PrewarmDelay, &launchService, [&launchService, prewarm]() {
+                launchService.prewarm(prewarm);
+            });
+    }
+
+    QScopedPointer<HeadlessDriver> headlessDriver;
+    if (headless)
+        headlessDriver.reset(new HeadlessDriver(root));
 
-    return app.exec();
+    int ret = app.exec();
+
+    if (!profilePath.isEmpty()) {
+        // one file per screen: frames.csv -> frames-HDMI-1.csv
+        QFileInfo fi(profilePath);
+        const QList<FrameProfiler *> profilers = root->findChildren<FrameProfiler *>();
+        for (FrameProfiler *profiler : profilers) {
+            QString screenName = profiler->window() ? profiler->window()->screen()->name() : QString();
+            profiler->dump(fi.path() + QLatin1Char('/') + fi.completeBaseName() + QLatin1Char('-') +
+                           screenName + QLatin1Char('.') + fi.suffix());
+        }
+    }
+    if (!logFilePath.isEmpty()) {
+        qInstallMessageHandler(nullptr);
+        AsyncLogger::instance()->stop();
+    }
+    if (!headlessConfigPath.isEmpty())
+        QFile::remove(headlessConfigPath);
+    return ret;
 }
@@ -0,0 +1,121 @@
+#include "occlusionculler.h"
+#include "framepacer.h"
+
+#include <QLoggingCategory>
+#include <QRegion>
+#include <QtWaylandCompositor/QWaylandQuickItem>
+#include <QtWaylandCompositor/QWaylandSurface>
+#include <algorithm>
+#include <cmath>
+
+Q_LOGGING_CATEGORY(lcOcclusion, "grefsen.compositor.occlusion")
+
+static const char *OccludedProperty = "occluded";
+static const char *BypassHiddenProperty = "bypassHidden";
+
+OcclusionCuller::OcclusionCuller(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void OcclusionCuller::setWindow(QQuickWindow *window)
+{
+    if (m_window == window)
+        return;
+    if (m_window)
+        disconnect(m_window, nullptr, this, nullptr);
+    m_window = window;
+    // on the GUI thread, once per frame, before the scene graph is synchronized
+    if (window)
+        connect(window, &QQuickWindow::afterAnimating, this, &OcclusionCuller::update);
+    emit windowChanged();
+}
+
+void OcclusionCuller::setEnabled(bool enabled)
+{
+    if (m_enabled == enabled)
+        return;
+    m_enabled = enabled;
+    emit enabledChanged();
+    update();
+}
+
+// paint order, reversed: by z, and then the later siblings first
+QList<QQuickItem *> OcclusionCuller::viewsTopDown() const
+{
+    QList<QQuickItem *> views = m_surfaceArea->childItems();
+    std::reverse(views.begin(), views.end());
+    std::stable_sort(views.begin(), views.end(), [](const QQuickItem *a, const QQuickItem *b) {
+        return a->z() > b->z();
+    });
+    return views;
+}
+
+// the part of the surface that certainly hides what's underneath it, in surfaceArea coordinates
+QRect OcclusionCuller::opaqueRect(QQuickItem *view, QQuickItem *surfaceItem) const
+{
+    QWaylandSurface *surface = static_cast<QWaylandQuickItem *>(surfaceItem)->surface();
+    if (!surface || !surface->property("isOpaque").toBool() || !surfaceItem->isVisible() ||
+            view->opacity() < 1 || surfaceItem->opacity() < 1)
+        return QRect();
+    const QRectF r = surfaceItem->mapRectToItem(m_surfaceArea, surfaceItem->boundingRect());
+    // only whole pixels
+    const int left = int(std::ceil(r.left()));
+    const int top = int(std::ceil(r.top()));
+    return QRect(QPoint(left, top), QPoint(int(std::floor(r.right())) - 1, int(std::floor(r.bottom())) - 1));
+}
+
+void OcclusionCuller::update()
+{
+    if (!m_surfaceArea)
+        return;
+    const QRect area = m_surfaceArea->boundingRect().toAlignedRect();
+    QRegion covered;
+    QSet<QWaylandSurface *> visible;
+    QSet<QWaylandSurface *> hidden;
+    QSet<QWaylandSurface *> moving;
+    int viewCount = 0;
+    int occludedCount = 0;
+    const QList<QQuickItem *> views = viewsTopDown();
+    for (QQuickItem *view : views) {
+        // FullscreenBypass takes care of everything while it's active
+        if (view->property(BypassHiddenProperty).toBool())
+            continue;
+        // Chrome; not the move items, which are also in the default output's surfaceArea
+        QQuickItem *surfaceItem = view->property("shellSurfaceItem").value<QQuickItem *>();
+        if (!surfaceItem)
+            continue;
+        const bool wasOccluded = view->property(OccludedProperty).toBool();
+        if (!view->isVisible() && !wasOccluded)
+            continue;
+        ++viewCount;
+        const bool isMoving = view->property("moving").toBool();
+        // the view's bounds include popups and other transient children
+        const QRect bounds = view->mapRectToItem(m_surfaceArea, view->boundingRect() | view->childrenRect()).toAlignedRect();
+        const bool isOccluded = m_enabled && !isMoving && !bounds.isEmpty() &&
+                (QRegion(bounds) - covered).isEmpty();
+        if (isOccluded != wasOccluded) {
+            qCDebug(lcOcclusion) << view << (isOccluded ? "is occluded" : "is visible again") << "on" << m_window;
+            view->setProperty(OccludedProperty, isOccluded);
+        }
+        if (isOccluded)
+            ++occludedCount;
+        if (QWaylandSurface *surface = static_cast<QWaylandQuickItem *>(surfaceItem)->surface()) {
+            // a window moved off the output still has a view on it, until it reaches another one
+            const bool offScreen = !bounds.isEmpty() && !bounds.intersects(area);
+            (isOccluded || offScreen ? hidden : visible).insert(surface);
+            if (isMoving || view->property("resizing").toBool())
+                moving.insert(surface);
+        }
+        if (!isOccluded)
+            covered += opaqueRect(view, surfaceItem);
+    }
+
+    if (m_framePacer && m_output)
+        m_framePacer->setOutputState(m_output, visible, hidden, moving);
+    if (viewCount != m_viewCount || occludedCount != m_occludedCount) {
+        m_viewCount = viewCount;
+        m_occludedCount = occludedCount;
+        emit statsChanged();
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef OCCLUSIONCULLER_H
+#define OCCLUSIONCULLER_H
+
+#include <QPointer>
+#include <QQuickItem>
+#include <QQuickWindow>
+
+class FramePacer;
+
+/*!
+    Hides the views in an output's \c surfaceArea that are completely
+    covered by opaque surfaces above them (in z order), so that the scene
+    graph doesn't render them, by setting their \c occluded property. Only
+    the client's own surface counts as covering what's underneath: the
+    window decorations are translucent.
+
+    Which surfaces are visible, which can't be seen (occluded, or off the
+    output), and which are being moved or resized is reported to the
+    FramePacer, which decides how often each client gets frame callbacks.
+
+    Visibility is worked out again after each animation step, so that a
+    view is shown again on the same frame on which whatever covered it
+    moves away.
+*/
+class OcclusionCuller : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(QQuickWindow *window READ window WRITE setWindow NOTIFY windowChanged)
+    Q_PROPERTY(QQuickItem *surfaceArea MEMBER m_surfaceArea NOTIFY surfaceAreaChanged)
+    Q_PROPERTY(QObject *output MEMBER m_output NOTIFY outputChanged)
+    Q_PROPERTY(FramePacer *framePacer MEMBER m_framePacer NOTIFY framePacerChanged)
+    Q_PROPERTY(bool enabled READ isEnabled WRITE setEnabled NOTIFY enabledChanged)
+    Q_PROPERTY(int viewCount READ viewCount NOTIFY statsChanged)
+    Q_PROPERTY(int occludedCount READ occludedCount NOTIFY statsChanged)
+
+public:
+    explicit OcclusionCuller(QObject *parent = nullptr);
+
+    QQuickWindow *window() const { return m_window; }
+    void setWindow(QQuickWindow *window);
+    bool isEnabled() const { return m_enabled; }
+    void setEnabled(bool enabled);
+    int viewCount() const { return m_viewCount; }
+    int occludedCount() const { return m_occludedCount; }
+
+signals:
+    void windowChanged();
+    void surfaceAreaChanged();
+    void outputChanged();
+    void framePacerChanged();
+    void enabledChanged();
+    void statsChanged();
+
+public slots:
+    void update();
+
+protected:
+    QList<QQuickItem *> viewsTopDown() const;
+    QRect opaqueRect(QQuickItem *view, QQuickItem *surfaceItem) const;
+
+protected:
+    QPointer<QQuickWindow> m_window;
+    QPointer<QQuickItem> m_surfaceArea;
+    QPointer<QObject> m_output;
+    QPointer<FramePacer> m_framePacer;
+    bool m_enabled = true;
+    int m_viewCount = 0;
+    int m_occludedCount = 0;
+};
+
+#endif // OCCLUSIONCULLER_H
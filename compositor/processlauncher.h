@@ -20,7 +20,6 @@
 #define PROCESSLAUNCHER_H
 
 #include <QObject>
-#include <QProcess>
 
 
 class WaylandProcessLauncher : public QObject
@@ -31,9 +30,6 @@ public:
     explicit WaylandProcessLauncher(QObject *parent = 0);
     ~WaylandProcessLauncher();
     Q_INVOKABLE void launch(const QString &program);
-protected slots:
-    void onError(QProcess::ProcessError error);
-    void onStateChanged(QProcess::ProcessState state);
 };
 
 #endif // PROCESSLAUNCHER_H
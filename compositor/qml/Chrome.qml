@@ -20,16 +20,17 @@ import QtQuick
 import QtQuick.Window
 import QtWayland.Compositor
 import QtWayland.Compositor.XdgShell
-import Qt5Compat.GraphicalEffects
 import com.theqtcompany.wlcompositor
 
 StackableItem {
     id: rootChrome
     property alias shellSurface: surfaceItem.shellSurface
+    property alias shellSurfaceItem: surfaceItem
     property var topLevel
     property alias moveItem: surfaceItem.moveItem
     property bool decorationVisible: false
     property bool moving: surfaceItem.moveItem ? surfaceItem.moveItem.moving : false
+    property bool resizing: decoration.resizing
     property alias destroyAnimation : destroyAnimationImpl
 
     property int marginWidth : surfaceItem.isFullscreen ? 0 : (surfaceItem.isPopup ? 1 : 6)
@@ -37,91 +38,46 @@ StackableItem {
     property string screenName: ""
 
     property real resizeAreaWidth: 12
+    property bool fullscreen: surfaceItem.isFullscreen
+    property bool bypassHidden: false // set by FullscreenBypass while a fullscreen window covers this one
+    property bool occluded: false // set by OcclusionCuller while opaque windows cover this one
+    property var damageTracker: surfaceItem.output ? surfaceItem.output.damageTracker : null
+    onDamageTrackerChanged: if (damageTracker) {
+        damageTracker.trackItem(rootChrome)
+        damageTracker.trackItem(surfaceItem)
+    }
+    property var frameProfiler: surfaceItem.output ? surfaceItem.output.frameProfiler : null
+    onFrameProfilerChanged: if (frameProfiler) frameProfiler.trackItem(surfaceItem)
 
     x: surfaceItem.moveItem.x - surfaceItem.output.geometry.x
     y: surfaceItem.moveItem.y - surfaceItem.output.geometry.y
     height: surfaceItem.height + marginWidth + titlebarHeight
     width: surfaceItem.width + 2 * marginWidth
-    visible: surfaceItem.valid
+    visible: surfaceItem.valid && !bypassHidden && !occluded
 
-    Rectangle {
+    WindowDecoration {
         id: decoration
         anchors.fill: parent
-        border.width: 1
-        radius: marginWidth
-        border.color: (rightEdgeHover.hovered || bottomEdgeHover.hovered) ? "#ffc02020" :"#305070a0"
+        marginWidth: rootChrome.marginWidth
+        titlebarHeight: surfaceItem.isPopup ? 0 : rootChrome.titlebarHeight
+        resizeAreaWidth: rootChrome.resizeAreaWidth
+        borderColor: hoveredEdges ? "#ffc02020" : "#305070a0"
         color: "#50ffffff"
+        titlebarTopColor: "#50ffffff"
+        titlebarBottomColor: "#e0ffffff"
+        closeGlowCenter: Qt.point(titlebar.x + closeButton.x + closeButton.width / 2,
+                                  titlebar.y + closeButton.y + closeButton.height / 2)
+        closeGlowRadius: 12
+        closeGlowColor: closeButtonHover.hovered && closeButton.visible ? "#88FF0000" : "transparent"
         visible: rootChrome.decorationVisible && !surfaceItem.isFullscreen &&
                  !topLevel || topLevel.decorationMode === XdgToplevel.ServerSideDecoration
 
-        // TODO write a ResizeHandler for this purpose? otherwise there are up to 8 components for edges and corners
-        Item {
-            id: rightEdgeResizeArea
-            x: parent.width - resizeAreaWidth / 2; width: resizeAreaWidth; height: parent.height - resizeAreaWidth
-            onXChanged:
-                if (horzDragHandler.active) {
-                    var size = topLevel.sizeForResize(horzDragHandler.initialSize,
-                                                      Qt.point(horzDragHandler.translation.x, horzDragHandler.translation.y),
-                                                      Qt.RightEdge);
-                    topLevel.sendConfigure(size, [3] /*XdgShellToplevel.ResizingState*/ )
-                }
-            DragHandler {
-                id: horzDragHandler
-                property size initialSize
-                onActiveChanged: if (active) initialSize = Qt.size(rootChrome.width, rootChrome.height)
-                yAxis.enabled: false
-            }
-            HoverHandler {
-                id: rightEdgeHover
-                cursorShape: Qt.SizeHorCursor // problem: this so far only sets the EGLFS cursor, not WaylandCursorItem
-            }
-        }
-        Item {
-            id: bottomEdgeResizeArea
-            y: parent.height - resizeAreaWidth / 2; height: resizeAreaWidth; width: parent.width - resizeAreaWidth
-            onYChanged:
-                if (vertDragHandler.active) {
-                    var size = topLevel.sizeForResize(vertDragHandler.initialSize,
-                                                      Qt.point(vertDragHandler.translation.x, vertDragHandler.translation.y),
-                                                      Qt.BottomEdge);
-                    topLevel.sendConfigure(size, [3] /*XdgShellToplevel.ResizingState*/ )
-                }
-            DragHandler {
-                id: vertDragHandler
-                property size initialSize
-                onActiveChanged: if (active) initialSize = Qt.size(rootChrome.width, rootChrome.height)
-                xAxis.enabled: false
-            }
-            HoverHandler {
-                id: bottomEdgeHover
-                cursorShape: Qt.SizeVerCursor
-            }
+        property size resizeStartSize
+        onResizeStarted: resizeStartSize = Qt.size(rootChrome.width, rootChrome.height)
+        onResizeUpdated: function(edges, translation) {
+            topLevel.sendConfigure(topLevel.sizeForResize(resizeStartSize, translation, edges),
+                                   [3] /*XdgShellToplevel.ResizingState*/ )
         }
-        Item {
-            id: bottomRightResizeArea
-            x: parent.width - resizeAreaWidth / 2; y: parent.height - resizeAreaWidth / 2
-            width: resizeAreaWidth; height: parent.height - resizeAreaWidth
-            onXChanged: resize()
-            onYChanged: resize()
-            function resize() {
-                if (bottomRightDragHandler.active) {
-                    var size = topLevel.sizeForResize(bottomRightDragHandler.initialSize,
-                                                      Qt.point(bottomRightDragHandler.translation.x, bottomRightDragHandler.translation.y),
-                                                      Qt.BottomEdge | Qt.RightEdge);
-                    topLevel.sendConfigure(size, [3] /*XdgShellToplevel.ResizingState*/ )
-                }
-            }
-            DragHandler {
-                id: bottomRightDragHandler
-                property size initialSize
-                onActiveChanged: if (active) initialSize = Qt.size(rootChrome.width, rootChrome.height)
-            }
-            HoverHandler {
-                id: bottomRightHover
-                cursorShape: Qt.SizeFDiagCursor
-            }
-        }
-        // end of resizing components
 
         Item {
             id: titlebar
@@ -132,16 +88,6 @@ StackableItem {
             height: titlebarHeight - marginWidth
             visible: !surfaceItem.isPopup
 
-            LinearGradient {
-                anchors.fill: parent
-                start: Qt.point(0, 0)
-                end: Qt.point(0, height)
-                gradient: Gradient {
-                    GradientStop { position: 0.0; color: "#50ffffff" }
-                    GradientStop { position: 1.0; color: "#e0ffffff" }
-                }
-            }
-
             Text {
                 color: "gray"
                 text: surfaceItem.shellSurface.title !== undefined ? surfaceItem.shellSurface.title : ""
@@ -178,7 +124,7 @@ StackableItem {
                 onTapped: rootChrome.lower()
             }
 
-            RectangularGlow {
+            Item {
                 id: closeButton
                 visible: !surfaceItem.isTransient
                 height: 8
@@ -186,14 +132,10 @@ StackableItem {
                 anchors.margins: marginWidth
                 anchors.right: parent.right
                 anchors.verticalCenter: parent.verticalCenter
-                glowRadius: 8
-                cornerRadius: glowRadius
-                spread: 0.4
-                color: closeButtonHover.hovered ? "#88FF0000" : "transparent"
                 Text {
                     id: closeIcon
                     anchors.centerIn: parent
-                    font.pixelSize: parent.height + parent.glowRadius
+                    font.pixelSize: parent.height + 8
                     font.family: "FontAwesome"
                     text: "\uf00d"
                 }
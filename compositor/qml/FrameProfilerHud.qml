@@ -0,0 +1,98 @@
+import QtQuick
+
+/*!
+    An overlay showing the statistics of a FrameProfiler: frame rate and
+    frame times, the scene graph's phases, and commit-to-present latency,
+    overall and per client.
+    If they are set, it also shows input event rates and latency from
+    \c input, how many windows \c culler is hiding, and which clients
+    \c pacer is throttling. Below that, a bar for the time between each
+    of the last frames (green up to 60 FPS, red beyond).
+*/
+Rectangle {
+    id: root
+    property var profiler
+    property var culler: null
+    property var input: null
+    property var pacer: null
+    property int graphFrames: 120
+    property real msPerPixel: 0.5
+    property var frameTimes: []
+
+    width: Math.max(stats.implicitWidth, graphFrames * 2) + 16
+    height: stats.implicitHeight + graph.height + 24
+    color: "#c0000000"
+    radius: 4
+
+    function refresh() {
+        frameTimes = profiler.recentFrameTimes(graphFrames)
+        var lines = [
+            profiler.fps.toFixed(1) + " FPS   frame " + profiler.averageFrameTime.toFixed(2) +
+                " ms, worst " + profiler.maxFrameTime.toFixed(2) + " ms",
+            "sync " + profiler.averageSyncTime.toFixed(2) + "  render " + profiler.averageRenderTime.toFixed(2) +
+                "  swap " + profiler.averageSwapTime.toFixed(2) + " ms",
+            "commit to present " + profiler.averageLatency.toFixed(2) + " ms, " +
+                profiler.commits + " commits presented"
+        ]
+        if (input)
+            lines.push("input " + input.eventsPerSecond + " events/s, " + input.coalescedPerSecond + " moves coalesced; latency " +
+                       input.averageLatency.toFixed(2) + " ms, worst " + input.maxLatency.toFixed(2) + " ms")
+        if (culler)
+            lines.push("occluded " + culler.occludedCount + " of " + culler.viewCount + " windows")
+        if (pacer) {
+            var throttled = pacer.clients
+            lines.push(throttled.length + " clients throttled" + (throttled.length ? ":" : ""))
+            for (var t = 0; t < throttled.length; ++t)
+                lines.push("  " + throttled[t].appId + ": " + (throttled[t].fps < 0 ? "suspended" : throttled[t].fps + " FPS"))
+        }
+        var clients = profiler.clients
+        for (var i = 0; i < clients.length; ++i)
+            lines.push("  " + clients[i].name + " (" + clients[i].pid + "): " + clients[i].averageLatency.toFixed(2) +
+                       " ms, worst " + clients[i].maxLatency.toFixed(2) + " ms")
+        stats.text = lines.join("\n")
+    }
+
+    Connections {
+        target: root.visible ? root.profiler : null
+        function onStatsChanged() { root.refresh() }
+    }
+    onVisibleChanged: if (visible) refresh()
+
+    Text {
+        id: stats
+        x: 8; y: 8
+        color: "white"
+        font.family: "monospace"
+        font.pixelSize: 12
+    }
+
+    Item {
+        id: graph
+        x: 8
+        anchors.top: stats.bottom
+        anchors.topMargin: 8
+        width: root.graphFrames * 2
+        height: 33.3 / root.msPerPixel
+
+        Rectangle {
+            // 16.7 ms
+            y: parent.height - 16.7 / root.msPerPixel
+            width: parent.width
+            height: 1
+            color: "#80ffffff"
+        }
+
+        Row {
+            anchors.bottom: parent.bottom
+            Repeater {
+                model: root.frameTimes
+                Rectangle {
+                    anchors.bottom: parent.bottom
+                    width: 2
+                    height: Math.min(graph.height, modelData / root.msPerPixel)
+                    color: modelData > 17 ? "red" : "lightgreen"
+                }
+            }
+        }
+    }
+}
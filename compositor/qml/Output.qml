@@ -20,20 +20,92 @@ import QtQuick 2.8
 import QtQuick.Window 2.3
 import QtWayland.Compositor 1.0
 import Grefsen 1.0
+import com.theqtcompany.wlcompositor
 
 WaylandOutput {
     id: output
-    property variant viewsBySurface: ({})
     property alias surfaceArea: compositorArea // Chrome instances are parented to compositorArea
+    property Item workspaceArea: compositorArea // the current workspace's item in compositorArea; set by WorkspaceManager
     property alias targetScreen: win.screen
+    property alias damageTracker: damage
+    property alias frameProfiler: frameProfilerImpl
+    property var framePacer: null
+    property var workspaceManager: null
+    property var windowSwitcher: null
     sizeFollowsWindow: true
 
     window: Window {
         id: win
         property Item customizedBackground: desktopLoader.item
+        property bool firstFrameShown: false // set by main.cpp
         color: "black"
         title: "Grefsen on " + Screen.name
 
+        DamageTracker {
+            id: damage
+            window: win
+        }
+
+        FrameProfiler {
+            id: frameProfilerImpl
+            window: win
+        }
+
+        Shortcut {
+            sequence: "Ctrl+Alt+Shift+P"
+            context: Qt.ApplicationShortcut
+            onActivated: hud.visible = !hud.visible
+        }
+
+        Shortcut {
+            sequence: "Ctrl+Alt+Right"
+            context: Qt.ApplicationShortcut
+            enabled: output.workspaceManager !== null
+            onActivated: output.workspaceManager.switchBy(1)
+        }
+
+        Shortcut {
+            sequence: "Ctrl+Alt+Left"
+            context: Qt.ApplicationShortcut
+            enabled: output.workspaceManager !== null
+            onActivated: output.workspaceManager.switchBy(-1)
+        }
+
+        // taking the focused window along
+        Shortcut {
+            sequence: "Ctrl+Alt+Shift+Right"
+            context: Qt.ApplicationShortcut
+            enabled: output.workspaceManager !== null
+            onActivated: output.workspaceManager.switchBy(1, true)
+        }
+
+        Shortcut {
+            sequence: "Ctrl+Alt+Shift+Left"
+            context: Qt.ApplicationShortcut
+            enabled: output.workspaceManager !== null
+            onActivated: output.workspaceManager.switchBy(-1, true)
+        }
+
+        FullscreenBypass {
+            window: win
+            surfaceArea: output.workspaceArea
+            background: background
+            glassPane: glassPane
+            onActiveChanged: damage.invalidate()
+        }
+
+        InputCoalescer {
+            id: inputCoalescer
+        }
+
+        OcclusionCuller {
+            id: occlusionCuller
+            window: win
+            surfaceArea: output.workspaceArea
+            output: output
+            framePacer: output.framePacer
+        }
+
         WaylandMouseTracker {
             id: mouseTracker
             objectName: "wmt on " + Screen.name
@@ -46,7 +118,12 @@ WaylandOutput {
                 Loader {
                     id: desktopLoader
                     anchors.fill: parent
+                    // the window's plain color is shown first; then the panels, clock etc.
+                    // are incubated in between frames
+                    active: win.firstFrameShown
+                    asynchronous: true
                     source: "file://" + Env.grefsenconfig + "screen.qml"
+                    onLoaded: startupTimer.mark("desktop loaded on " + Screen.name)
                 }
             }
             Item {
@@ -63,6 +140,28 @@ WaylandOutput {
                 id: glassPane
                 objectName: "glassPane"
                 anchors.fill: parent
+
+                Loader {
+                    anchors.centerIn: parent
+                    active: output.windowSwitcher !== null && output.windowSwitcher.open
+                    sourceComponent: WindowSwitcherPanel {
+                        switcher: output.windowSwitcher
+                        thumbnails: thumbnailCache
+                        maxWidth: glassPane.width * 0.8
+                    }
+                }
+
+                FrameProfilerHud {
+                    id: hud
+                    profiler: frameProfilerImpl
+                    culler: occlusionCuller
+                    input: inputCoalescer
+                    pacer: output.framePacer
+                    visible: false
+                    anchors.right: parent.right
+                    anchors.top: parent.top
+                    anchors.margins: 10
+                }
             }
             WaylandCursorItem {
                 id: cursor
@@ -70,6 +169,7 @@ WaylandOutput {
                 y: mouseTracker.mouseY
                 seat: output.compositor.defaultSeat
                 visible: mouseTracker.containsMouse
+                Component.onCompleted: damage.trackItem(cursor)
             }
         }
     }
@@ -0,0 +1,75 @@
+import QtQuick
+
+/*!
+    The windows of a WindowSwitcher, as thumbnails from a ThumbnailCache,
+    with the selected one highlighted. Only exists while the switcher is
+    open; the pictures are whatever the cache has, and get replaced when
+    it has newer ones.
+*/
+Rectangle {
+    id: root
+    property var switcher
+    property var thumbnails
+    property int cellSize: 160
+    property real maxWidth: 1280
+    property int columns: Math.max(1, Math.min(switcher.windows.length, Math.floor(maxWidth / (cellSize + grid.spacing))))
+
+    width: grid.implicitWidth + 32
+    height: grid.implicitHeight + 32
+    color: "#d0202020"
+    radius: 8
+
+    Grid {
+        id: grid
+        anchors.centerIn: parent
+        columns: root.columns
+        spacing: 12
+
+        Repeater {
+            model: root.switcher.windows
+            delegate: Item {
+                width: root.cellSize
+                height: root.cellSize + title.height
+
+                Rectangle {
+                    anchors.fill: thumbnail
+                    anchors.margins: -4
+                    color: "transparent"
+                    border.color: "#a0c0ff"
+                    border.width: 2
+                    radius: 4
+                    visible: index === root.switcher.currentIndex
+                }
+
+                Image {
+                    id: thumbnail
+                    anchors.horizontalCenter: parent.horizontalCenter
+                    width: root.cellSize
+                    height: root.cellSize
+                    fillMode: Image.PreserveAspectFit
+                    // the cache keeps the images within its budget; the pixmap cache would hold on to old ones
+                    cache: false
+                    source: root.thumbnails ? (root.thumbnails.revision, root.thumbnails.url(modelData)) : ""
+                }
+
+                Text {
+                    id: title
+                    anchors.top: thumbnail.bottom
+                    anchors.topMargin: 4
+                    width: parent.width
+                    horizontalAlignment: Text.AlignHCenter
+                    elide: Text.ElideRight
+                    color: "white"
+                    text: modelData.toplevel ? modelData.toplevel.title : (modelData.title !== undefined ? modelData.title : "")
+                }
+
+                TapHandler {
+                    onTapped: {
+                        root.switcher.currentIndex = index
+                        root.switcher.commit()
+                    }
+                }
+            }
+        }
+    }
+}
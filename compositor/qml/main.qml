@@ -21,16 +21,23 @@ import QtWayland.Compositor
 import QtWayland.Compositor.XdgShell
 import QtWayland.Compositor.WlShell
 import Qt.labs.settings
+import com.theqtcompany.wlcompositor
 
 WaylandCompositor {
     id: comp
+    property var outputs: []
 
     Instantiator {
         id: screens
         model: Qt.application.screens
+        onObjectAdded: function(index, object) { comp.outputs = comp.outputs.concat([object]) }
+        onObjectRemoved: function(index, object) { comp.outputs = comp.outputs.filter(function(o) { return o !== object }) }
 
         delegate: Output {
             compositor: comp
+            framePacer: framePacer
+            workspaceManager: workspaceManager
+            windowSwitcher: windowSwitcher
             targetScreen: modelData
             Component.onCompleted: if (!comp.defaultOutput) comp.defaultOutput = this
             position: Qt.point(virtualX, virtualY)
@@ -43,6 +50,14 @@ WaylandCompositor {
         }
     }
 
+    Component {
+        id: viewTrackerComponent
+        SurfaceViewTracker {
+            delegate: chromeComponent
+            outputs: comp.outputs
+        }
+    }
+
     Component {
         id: moveItemComponent
         Item {
@@ -50,6 +65,36 @@ WaylandCompositor {
         }
     }
 
+    WorkspaceManager {
+        id: workspaceManager
+        compositor: comp
+        framePacer: framePacer
+        outputs: comp.outputs
+    }
+
+    FramePacer {
+        id: framePacer
+        compositor: comp
+    }
+
+    WindowSwitcher {
+        id: windowSwitcher
+        compositor: comp
+        workspaceManager: workspaceManager
+    }
+
+    // thumbnails are only refreshed while someone is looking at them
+    Binding {
+        target: thumbnailCache
+        property: "active"
+        value: windowSwitcher.open
+    }
+
+    SessionLayout {
+        id: sessionLayout
+        workspaceManager: workspaceManager
+    }
+
     QtWindowManager {
         id: qtWindowManager
         onShowIsFullScreenChanged: console.debug("Show is fullscreen hint for Qt applications:", showIsFullScreen)
@@ -88,26 +133,6 @@ WaylandCompositor {
         property string model: ""
     }
 
-    function createShellSurfaceItem(shellSurface, topLevel, moveItem, output, decorate) {
-        var parentSurfaceItem = output.viewsBySurface[shellSurface.parentSurface];
-        var parent = parentSurfaceItem || output.surfaceArea;
-        var item = chromeComponent.createObject(parent, {
-            "shellSurface": shellSurface,
-            "topLevel": topLevel,
-            "moveItem": moveItem,
-            "output": output,
-            "screenName": output.targetScreen.name,
-            "decorationVisible": decorate
-        });
-        if (parentSurfaceItem !== undefined) {
-            item.x += output.position.x;
-            item.y += output.position.y;
-        }
-        output.viewsBySurface[shellSurface.surface] = item;
-        console.log(lcComp, "shellSurface:", shellSurface, "topLevel:", topLevel, "moveItem:", moveItem, "output:", output,
-                    "decorate:", decorate, "parentSurfaceItem:", parentSurfaceItem, "new surface item:", output.viewsBySurface[shellSurface.surface])
-    }
-
     function handleShellSurfaceCreated(shellSurface, topLevel, decorate) {
         var moveItem = moveItemComponent.createObject(defaultOutput.surfaceArea, {
             "x": screens.objectAt(0).position.x,
@@ -115,8 +140,17 @@ WaylandCompositor {
             "width": Qt.binding(function() { return shellSurface.surface.width; }),
             "height": Qt.binding(function() { return shellSurface.surface.height; })
         });
-        for (var i = 0; i < screens.count; ++i)
-            createShellSurfaceItem(shellSurface, topLevel, moveItem, screens.objectAt(i), decorate);
+        // Chrome instances are created only on the outputs that the window overlaps
+        var tracker = viewTrackerComponent.createObject(comp, {
+            "shellSurface": shellSurface,
+            "topLevel": topLevel,
+            "moveItem": moveItem,
+            "decorate": decorate
+        });
+        workspaceManager.track(shellSurface);
+        sessionLayout.track(shellSurface, topLevel, moveItem);
+        console.log(lcComp, "shellSurface:", shellSurface, "topLevel:", topLevel, "moveItem:", moveItem,
+                    "decorate:", decorate, "views:", tracker.viewCount)
     }
 
     LoggingCategory {
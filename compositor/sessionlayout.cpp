@@ -0,0 +1,224 @@
+#include "sessionlayout.h"
+#include "stackableitem.h"
+#include "supervisor.h"
+#include "surfaceviewtracker.h"
+#include "workspacemanager.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QLoggingCategory>
+#include <QSaveFile>
+#include <QtWaylandCompositor/QWaylandClient>
+#include <QtWaylandCompositor/QWaylandSurface>
+#include <algorithm>
+
+Q_LOGGING_CATEGORY(lcLayout, "grefsen.compositor.layout")
+
+static const int SaveDelay = 250; // ms
+static const int StackingDelay = 50; // ms; windows reconnect in bursts
+
+SessionLayout::SessionLayout(QObject *parent)
+    : QObject(parent)
+    , m_filePath(Supervisor::layoutFilePath())
+{
+    m_saveTimer.setSingleShot(true);
+    m_saveTimer.setInterval(SaveDelay);
+    connect(&m_saveTimer, &QTimer::timeout, this, &SessionLayout::save);
+    m_stackingTimer.setSingleShot(true);
+    m_stackingTimer.setInterval(StackingDelay);
+    connect(&m_stackingTimer, &QTimer::timeout, this, &SessionLayout::restoreStacking);
+    load();
+}
+
+void SessionLayout::setFilePath(const QString &filePath)
+{
+    if (m_filePath == filePath)
+        return;
+    m_filePath = filePath;
+    load();
+    emit filePathChanged();
+}
+
+void SessionLayout::setWorkspaceManager(WorkspaceManager *workspaceManager)
+{
+    if (m_workspaceManager == workspaceManager)
+        return;
+    if (m_workspaceManager)
+        disconnect(m_workspaceManager, nullptr, this, nullptr);
+    m_workspaceManager = workspaceManager;
+    if (workspaceManager)
+        connect(workspaceManager, &WorkspaceManager::windowMoved, this, [this]() { m_saveTimer.start(); });
+    emit workspaceManagerChanged();
+}
+
+void SessionLayout::load()
+{
+    m_saved.clear();
+    if (m_filePath.isEmpty())
+        return;
+    QFile f(m_filePath);
+    if (!f.open(QIODevice::ReadOnly))
+        return;
+    const QJsonArray windows = QJsonDocument::fromJson(f.readAll()).object().value(QLatin1String("windows")).toArray();
+    for (const QJsonValue &v : windows) {
+        QJsonObject o = v.toObject();
+        m_saved.insert(o.value(QLatin1String("key")).toString(), o);
+    }
+    qCDebug(lcLayout) << "loaded" << m_saved.count() << "windows from" << m_filePath;
+}
+
+SessionLayout::Window *SessionLayout::find(QObject *shellSurface)
+{
+    for (Window &w : m_windows)
+        if (w.shellSurface == shellSurface)
+            return &w;
+    return nullptr;
+}
+
+void SessionLayout::track(QObject *shellSurface, QObject *topLevel, QQuickItem *moveItem)
+{
+    if (!shellSurface || !moveItem || find(shellSurface))
+        return;
+    Window w;
+    w.shellSurface = shellSurface;
+    w.topLevel = topLevel;
+    w.moveItem = moveItem;
+    m_windows.append(w);
+
+    // the app id is only known once the client has committed its first buffer
+    connect(moveItem, &QQuickItem::widthChanged, this, [this, shellSurface]() {
+        Window *w = find(shellSurface);
+        if (w && w->key.isEmpty() && w->moveItem && w->moveItem->width() > 0)
+            mapped(*w);
+    });
+    auto changed = [this]() { m_saveTimer.start(); };
+    connect(moveItem, &QQuickItem::xChanged, this, changed);
+    connect(moveItem, &QQuickItem::yChanged, this, changed);
+    connect(moveItem, &QQuickItem::heightChanged, this, changed);
+    connect(shellSurface, &QObject::destroyed, this, [this]() {
+        m_windows.erase(std::remove_if(m_windows.begin(), m_windows.end(),
+                                       [](const Window &w) { return w.shellSurface.isNull(); }), m_windows.end());
+        m_saveTimer.start();
+    });
+
+    if (SurfaceViewTracker *tracker = SurfaceViewTracker::trackerFor(shellSurface->property("surface").value<QObject *>())) {
+        auto watchView = [this, changed](QQuickItem *view) {
+            if (StackableItem *stackable = qobject_cast<StackableItem *>(view))
+                connect(stackable, &StackableItem::stackingChanged, this, changed);
+        };
+        const QList<QQuickItem *> views = tracker->views();
+        for (QQuickItem *view : views)
+            watchView(view);
+        connect(tracker, &SurfaceViewTracker::viewCreated, this, watchView);
+    }
+}
+
+QString SessionLayout::windowKey(const Window &window) const
+{
+    QWaylandSurface *surface = window.shellSurface->property("surface").value<QWaylandSurface *>();
+    const qint64 pid = surface && surface->client() ? surface->client()->processId() : 0;
+    QString appId = window.topLevel ? window.topLevel->property("appId").toString() : QString();
+    if (appId.isEmpty())
+        appId = window.shellSurface->property("className").toString(); // wl_shell
+    const QString prefix = QString::number(pid) + QLatin1Char('/') + appId + QLatin1Char('/');
+    int ordinal = 0;
+    for (const Window &w : m_windows)
+        if (&w != &window && w.key.startsWith(prefix))
+            ++ordinal;
+    return prefix + QString::number(ordinal);
+}
+
+void SessionLayout::mapped(Window &window)
+{
+    window.key = windowKey(window);
+    auto saved = m_saved.find(window.key);
+    if (saved != m_saved.end()) {
+        const QJsonObject o = *saved;
+        m_saved.erase(saved);
+        window.moveItem->setX(o.value(QLatin1String("x")).toDouble());
+        window.moveItem->setY(o.value(QLatin1String("y")).toDouble());
+        if (m_workspaceManager && o.contains(QLatin1String("workspace")))
+            m_workspaceManager->moveToWorkspace(window.shellSurface, o.value(QLatin1String("workspace")).toInt());
+        window.restoredStack = o.value(QLatin1String("stack")).toInt(-1);
+        if (window.restoredStack >= 0)
+            m_stackingTimer.start();
+        qCDebug(lcLayout) << "restored" << window.key << "at" << window.moveItem->position();
+        emit restored(window.shellSurface);
+    }
+    m_saveTimer.start();
+}
+
+void SessionLayout::restoreStacking()
+{
+    QVector<Window *> restored;
+    for (Window &w : m_windows)
+        if (w.restoredStack >= 0)
+            restored << &w;
+    std::sort(restored.begin(), restored.end(), [](const Window *a, const Window *b) {
+        return a->restoredStack < b->restoredStack;
+    });
+    // raising each in turn, from the bottom up, leaves them in the saved order
+    for (Window *w : qAsConst(restored)) {
+        if (m_workspaceManager) {
+            m_workspaceManager->raise(w->shellSurface);
+            continue;
+        }
+        SurfaceViewTracker *tracker = SurfaceViewTracker::trackerFor(w->shellSurface->property("surface").value<QObject *>());
+        const QList<QQuickItem *> views = tracker ? tracker->views() : QList<QQuickItem *>();
+        for (QQuickItem *view : views)
+            if (StackableItem *stackable = qobject_cast<StackableItem *>(view))
+                stackable->raise();
+    }
+    // once everyone is back, ordinary stacking takes over
+    if (m_saved.isEmpty())
+        for (Window *w : qAsConst(restored))
+            w->restoredStack = -1;
+}
+
+void SessionLayout::save()
+{
+    if (m_filePath.isEmpty())
+        return;
+    QJsonArray windows;
+    for (const Window &w : qAsConst(m_windows)) {
+        if (w.key.isEmpty() || !w.moveItem)
+            continue;
+        QJsonObject o;
+        o.insert(QLatin1String("key"), w.key);
+        if (w.topLevel)
+            o.insert(QLatin1String("title"), w.topLevel->property("title").toString());
+        o.insert(QLatin1String("x"), w.moveItem->x());
+        o.insert(QLatin1String("y"), w.moveItem->y());
+        o.insert(QLatin1String("width"), w.moveItem->width());
+        o.insert(QLatin1String("height"), w.moveItem->height());
+        SurfaceViewTracker *tracker = SurfaceViewTracker::trackerFor(w.shellSurface->property("surface").value<QObject *>());
+        const QList<QQuickItem *> views = tracker ? tracker->views() : QList<QQuickItem *>();
+        QJsonArray outputs;
+        for (QQuickItem *view : views) {
+            outputs.append(view->property("screenName").toString());
+            if (!m_workspaceManager && !o.contains(QLatin1String("stack")) && view->parentItem())
+                o.insert(QLatin1String("stack"), view->parentItem()->childItems().indexOf(view));
+        }
+        if (m_workspaceManager) {
+            o.insert(QLatin1String("workspace"), m_workspaceManager->workspaceOf(w.shellSurface));
+            o.insert(QLatin1String("stack"), m_workspaceManager->stackIndex(w.shellSurface));
+        }
+        o.insert(QLatin1String("outputs"), outputs);
+        windows.append(o);
+    }
+    // windows that haven't come back yet, in case we crash again before they do
+    for (const QJsonObject &o : qAsConst(m_saved))
+        windows.append(o);
+
+    QSaveFile f(m_filePath);
+    if (!f.open(QIODevice::WriteOnly)) {
+        qWarning() << "failed to save window layout" << m_filePath << f.errorString();
+        return;
+    }
+    QJsonObject doc;
+    doc.insert(QLatin1String("windows"), windows);
+    f.write(QJsonDocument(doc).toJson(QJsonDocument::Compact));
+    if (!f.commit())
+        qWarning() << "failed to save window layout" << m_filePath << f.errorString();
+}
@@ -0,0 +1,72 @@
+#ifndef SESSIONLAYOUT_H
+#define SESSIONLAYOUT_H
+
+#include <QHash>
+#include <QJsonObject>
+#include <QPointer>
+#include <QQuickItem>
+#include <QTimer>
+#include <QVector>
+
+class WorkspaceManager;
+
+/*!
+    Remembers where each window is, for a compositor restarted by the
+    supervisor: positions, sizes, workspaces, stacking order and outputs are
+    written (shortly after every change) to a file next to the Wayland
+    socket, and when a client that reconnects after a crash maps a window
+    again, its old position, workspace and stacking order are restored.
+
+    Windows are recognized by the client's pid, the app id, and the order
+    in which that client's windows with the same app id appeared.
+*/
+class SessionLayout : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(QString filePath READ filePath WRITE setFilePath NOTIFY filePathChanged)
+    Q_PROPERTY(WorkspaceManager *workspaceManager READ workspaceManager WRITE setWorkspaceManager NOTIFY workspaceManagerChanged)
+
+public:
+    explicit SessionLayout(QObject *parent = nullptr);
+
+    QString filePath() const { return m_filePath; }
+    void setFilePath(const QString &filePath);
+
+    WorkspaceManager *workspaceManager() const { return m_workspaceManager; }
+    void setWorkspaceManager(WorkspaceManager *workspaceManager);
+
+    Q_INVOKABLE void track(QObject *shellSurface, QObject *topLevel, QQuickItem *moveItem);
+
+signals:
+    void filePathChanged();
+    void workspaceManagerChanged();
+    void restored(QObject *shellSurface);
+
+public slots:
+    void save();
+
+protected:
+    struct Window {
+        QPointer<QObject> shellSurface;
+        QPointer<QObject> topLevel;
+        QPointer<QQuickItem> moveItem;
+        QString key;
+        int restoredStack = -1;
+    };
+
+    void load();
+    void mapped(Window &window);
+    void restoreStacking();
+    QString windowKey(const Window &window) const;
+    Window *find(QObject *shellSurface);
+
+protected:
+    QString m_filePath;
+    QPointer<WorkspaceManager> m_workspaceManager;
+    QVector<Window> m_windows;
+    QHash<QString, QJsonObject> m_saved;
+    QTimer m_saveTimer;
+    QTimer m_stackingTimer;
+};
+
+#endif // SESSIONLAYOUT_H
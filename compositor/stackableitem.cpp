@@ -1,25 +1,43 @@
 #include "stackableitem.h"
+#include "stackingmanager.h"
 
 StackableItem::StackableItem()
 {
 
 }
 
+void StackableItem::setStackingManager(StackingManager *manager, QObject *window)
+{
+    m_stackingManager = manager;
+    m_window = window;
+}
 
 void StackableItem::lower()
 {
+    if (m_stackingManager) {
+        m_stackingManager->lower(m_window);
+        return;
+    }
     QQuickItem *parent = parentItem();
     Q_ASSERT(parent);
     QQuickItem *bottom = parent->childItems().first();
-    if (this != bottom)
+    if (this != bottom) {
         stackBefore(bottom);
+        emit stackingChanged();
+    }
 }
 
 void StackableItem::raise()
 {
+    if (m_stackingManager) {
+        m_stackingManager->raise(m_window);
+        return;
+    }
     QQuickItem *parent = parentItem();
     Q_ASSERT(parent);
     QQuickItem *top = parent->childItems().last();
-    if (this != top)
+    if (this != top) {
         stackAfter(top);
+        emit stackingChanged();
+    }
 }
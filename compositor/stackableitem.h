@@ -1,17 +1,30 @@
 #ifndef STACKABLEITEM_H
 #define STACKABLEITEM_H
 
+#include <QPointer>
 #include <QQuickItem>
 
+class StackingManager;
+
 class StackableItem : public QQuickItem
 {
     Q_OBJECT
 public:
     StackableItem();
 
+    // raise() and lower() restack the whole window, on all outputs
+    void setStackingManager(StackingManager *manager, QObject *window);
+
 public Q_SLOTS:
     void raise();
     void lower();
+
+Q_SIGNALS:
+    void stackingChanged();
+
+private:
+    QPointer<StackingManager> m_stackingManager;
+    QPointer<QObject> m_window;
 };
 
 #endif // STACKABLEITEM_H
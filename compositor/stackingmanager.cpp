@@ -0,0 +1,164 @@
+#include "stackingmanager.h"
+#include "stackableitem.h"
+#include "surfaceviewtracker.h"
+
+#include <QLoggingCategory>
+
+Q_LOGGING_CATEGORY(lcStacking, "grefsen.compositor.stacking")
+
+StackingManager::StackingManager(QObject *parent)
+    : QObject(parent)
+{
+}
+
+StackingManager::~StackingManager()
+{
+    for (Node *node : qAsConst(m_nodes)) {
+        if (node->tracker) {
+            disconnect(node->tracker, nullptr, this, nullptr);
+            const QList<QQuickItem *> views = node->tracker->views();
+            for (QQuickItem *view : views)
+                if (StackableItem *stackable = qobject_cast<StackableItem *>(view))
+                    stackable->setStackingManager(nullptr, nullptr);
+        }
+        delete node;
+    }
+}
+
+QList<QObject *> StackingManager::windows() const
+{
+    QList<QObject *> ret;
+    ret.reserve(m_nodes.count());
+    for (Node *node = m_bottom; node; node = node->above)
+        ret << node->shellSurface.data();
+    return ret;
+}
+
+int StackingManager::stackIndex(QObject *shellSurface) const
+{
+    int i = 0;
+    for (Node *node = m_bottom; node; node = node->above, ++i)
+        if (node->shellSurface == shellSurface)
+            return i;
+    return -1;
+}
+
+void StackingManager::track(QObject *shellSurface)
+{
+    if (!shellSurface || m_nodes.contains(shellSurface))
+        return;
+    Node *node = new Node;
+    node->shellSurface = shellSurface;
+    node->tracker = SurfaceViewTracker::trackerFor(shellSurface->property("surface").value<QObject *>());
+    m_nodes.insert(shellSurface, node);
+    linkOnTop(node);
+    node->z = ++m_topZ;
+    adoptViews(node);
+    connect(shellSurface, &QObject::destroyed, this, [this, shellSurface]() { untrack(shellSurface); });
+    emit orderChanged();
+}
+
+void StackingManager::untrack(QObject *shellSurface)
+{
+    Node *node = m_nodes.take(shellSurface);
+    if (!node)
+        return;
+    unlink(node);
+    if (node->tracker)
+        disconnect(node->tracker, nullptr, this, nullptr);
+    if (shellSurface)
+        disconnect(shellSurface, nullptr, this, nullptr);
+    delete node;
+    emit orderChanged();
+}
+
+void StackingManager::raise(QObject *shellSurface)
+{
+    Node *node = m_nodes.value(shellSurface);
+    if (!node || node == m_top)
+        return;
+    unlink(node);
+    linkOnTop(node);
+    node->z = ++m_topZ;
+    applyZ(node);
+    qCDebug(lcStacking) << "raised" << shellSurface << "to" << node->z;
+    emit orderChanged();
+}
+
+void StackingManager::lower(QObject *shellSurface)
+{
+    Node *node = m_nodes.value(shellSurface);
+    if (!node || node == m_bottom)
+        return;
+    unlink(node);
+    linkAtBottom(node);
+    node->z = --m_bottomZ;
+    applyZ(node);
+    qCDebug(lcStacking) << "lowered" << shellSurface << "to" << node->z;
+    emit orderChanged();
+}
+
+void StackingManager::unlink(Node *node)
+{
+    if (node->below)
+        node->below->above = node->above;
+    else
+        m_bottom = node->above;
+    if (node->above)
+        node->above->below = node->below;
+    else
+        m_top = node->below;
+    node->below = node->above = nullptr;
+}
+
+void StackingManager::linkOnTop(Node *node)
+{
+    node->below = m_top;
+    if (m_top)
+        m_top->above = node;
+    else
+        m_bottom = node;
+    m_top = node;
+}
+
+void StackingManager::linkAtBottom(Node *node)
+{
+    node->above = m_bottom;
+    if (m_bottom)
+        m_bottom->below = node;
+    else
+        m_top = node;
+    m_bottom = node;
+}
+
+// one pass over the window's views: one per output that it's on
+void StackingManager::applyZ(Node *node)
+{
+    if (!node->tracker)
+        return;
+    const QList<QQuickItem *> views = node->tracker->views();
+    for (QQuickItem *view : views) {
+        view->setZ(node->z);
+        if (StackableItem *stackable = qobject_cast<StackableItem *>(view))
+            emit stackable->stackingChanged();
+    }
+}
+
+void StackingManager::adoptViews(Node *node)
+{
+    if (!node->tracker)
+        return;
+    QObject *shellSurface = node->shellSurface;
+    auto adopt = [this, shellSurface](QQuickItem *view) {
+        Node *node = m_nodes.value(shellSurface);
+        if (!node)
+            return;
+        view->setZ(node->z);
+        if (StackableItem *stackable = qobject_cast<StackableItem *>(view))
+            stackable->setStackingManager(this, shellSurface);
+    };
+    const QList<QQuickItem *> views = node->tracker->views();
+    for (QQuickItem *view : views)
+        adopt(view);
+    connect(node->tracker, &SurfaceViewTracker::viewCreated, this, adopt);
+}
@@ -0,0 +1,74 @@
+#ifndef STACKINGMANAGER_H
+#define STACKINGMANAGER_H
+
+#include <QHash>
+#include <QObject>
+#include <QPointer>
+
+class SurfaceViewTracker;
+
+/*!
+    The z-order of the windows: a doubly linked list from bottom to top,
+    with each window's node found by its shell surface, so raising or
+    lowering a window takes constant time no matter how many there are.
+    The views of a window on all outputs get the window's z value (which
+    only ever grows when raising, or shrinks when lowering), rather than
+    being moved around in their parents' lists of children; the scene graph
+    sorts each parent's children at most once per frame.
+
+    A StackingManager holds the windows of one workspace. StackableItem's
+    raise() and lower() go through it, for the views that it manages.
+*/
+class StackingManager : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(QList<QObject *> windows READ windows NOTIFY orderChanged)
+    Q_PROPERTY(QObject *topWindow READ topWindow NOTIFY orderChanged)
+    Q_PROPERTY(int count READ count NOTIFY orderChanged)
+
+public:
+    explicit StackingManager(QObject *parent = nullptr);
+    ~StackingManager() override;
+
+    // the shell surfaces, from bottom to top
+    QList<QObject *> windows() const;
+    QObject *topWindow() const { return m_top ? m_top->shellSurface.data() : nullptr; }
+    QObject *bottomWindow() const { return m_bottom ? m_bottom->shellSurface.data() : nullptr; }
+    int count() const { return m_nodes.count(); }
+
+    Q_INVOKABLE void track(QObject *shellSurface);
+    Q_INVOKABLE void untrack(QObject *shellSurface);
+    Q_INVOKABLE bool contains(QObject *shellSurface) const { return m_nodes.contains(shellSurface); }
+    Q_INVOKABLE int stackIndex(QObject *shellSurface) const;
+
+public slots:
+    void raise(QObject *shellSurface);
+    void lower(QObject *shellSurface);
+
+signals:
+    void orderChanged();
+
+protected:
+    struct Node {
+        QPointer<QObject> shellSurface;
+        QPointer<SurfaceViewTracker> tracker;
+        Node *below = nullptr;
+        Node *above = nullptr;
+        qreal z = 0;
+    };
+
+    void unlink(Node *node);
+    void linkOnTop(Node *node);
+    void linkAtBottom(Node *node);
+    void applyZ(Node *node);
+    void adoptViews(Node *node);
+
+protected:
+    QHash<QObject *, Node *> m_nodes;
+    Node *m_bottom = nullptr;
+    Node *m_top = nullptr;
+    qreal m_topZ = 0;
+    qreal m_bottomZ = 0;
+};
+
+#endif // STACKINGMANAGER_H
@@ -0,0 +1,18 @@
+#include "startuptimer.h"
+
+#include <QLoggingCategory>
+
+Q_LOGGING_CATEGORY(lcStartup, "grefsen.compositor.startup", QtInfoMsg)
+
+StartupTimer::StartupTimer(const QElapsedTimer &sinceStartup, QObject *parent)
+    : QObject(parent)
+    , m_sinceStartup(sinceStartup)
+{
+}
+
+void StartupTimer::mark(const QString &phase)
+{
+    const qint64 now = m_sinceStartup.nsecsElapsed();
+    qCInfo(lcStartup, "%8.2f ms (+%7.2f ms) %s", now / 1000000.0, (now - m_last) / 1000000.0, qPrintable(phase));
+    m_last = now;
+}
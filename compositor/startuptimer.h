@@ -0,0 +1,31 @@
+#ifndef STARTUPTIMER_H
+#define STARTUPTIMER_H
+
+#include <QElapsedTimer>
+#include <QObject>
+
+/*!
+    Logs how long each phase of startup took (in the grefsen.compositor.startup
+    category): the time since the process started, and since the previous
+    phase. main() marks the phases up to showing the windows, and the
+    first frame swapped on each output; Output.qml marks the time when the
+    desktop from screen.qml has been loaded on each output.
+
+    The breakdown is logged by default, a few lines per start; disable it
+    with QT_LOGGING_RULES="grefsen.compositor.startup.info=false".
+*/
+class StartupTimer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit StartupTimer(const QElapsedTimer &sinceStartup, QObject *parent = nullptr);
+
+    Q_INVOKABLE void mark(const QString &phase);
+
+protected:
+    const QElapsedTimer &m_sinceStartup;
+    qint64 m_last = 0;
+};
+
+#endif // STARTUPTIMER_H
@@ -0,0 +1,181 @@
+#include "supervisor.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+bool Supervisor::s_supervised = false;
+int Supervisor::s_socketFd = -1;
+int Supervisor::s_lockFd = -1;
+int Supervisor::s_readyFd = -1;
+QByteArray Supervisor::s_socketName;
+QByteArray Supervisor::s_socketPath;
+
+static const int MaxSockets = 32;
+static const int CrashWindow = 10000; // ms
+static const int MaxCrashesInWindow = 5;
+
+static qint64 monotonicMs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return qint64(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+// like wl_display_add_socket_auto(): the first name whose lock file we can get
+bool Supervisor::bindSocket()
+{
+    const char *runtimeDir = getenv("XDG_RUNTIME_DIR");
+    if (!runtimeDir) {
+        fprintf(stderr, "grefsen supervisor: XDG_RUNTIME_DIR is not set\n");
+        return false;
+    }
+    for (int i = 0; i < MaxSockets; ++i) {
+        QByteArray name = "grefsen-" + QByteArray::number(i);
+        QByteArray path = QByteArray(runtimeDir) + '/' + name;
+        QByteArray lockPath = path + ".lock";
+        int lockFd = open(lockPath.constData(), O_CREAT | O_CLOEXEC | O_RDWR, 0660);
+        if (lockFd < 0)
+            continue;
+        if (flock(lockFd, LOCK_EX | LOCK_NB) < 0) {
+            close(lockFd);
+            continue;
+        }
+        // we hold the lock, so a socket file left behind is stale
+        unlink(path.constData());
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (fd < 0 || size_t(path.size()) >= sizeof(addr.sun_path)) {
+            close(lockFd);
+            if (fd >= 0)
+                close(fd);
+            return false;
+        }
+        memcpy(addr.sun_path, path.constData(), size_t(path.size()));
+        if (bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0 || listen(fd, 128) < 0) {
+            fprintf(stderr, "grefsen supervisor: failed to listen on %s: %s\n", path.constData(), strerror(errno));
+            close(fd);
+            close(lockFd);
+            continue;
+        }
+        s_socketFd = fd;
+        s_lockFd = lockFd;
+        s_socketName = name;
+        s_socketPath = path;
+        return true;
+    }
+    return false;
+}
+
+QString Supervisor::layoutFilePath()
+{
+    if (s_socketPath.isEmpty())
+        return QString();
+    return QString::fromLocal8Bit(s_socketPath + ".layout");
+}
+
+void Supervisor::notifyReady()
+{
+    if (s_readyFd < 0)
+        return;
+    char c = 1;
+    ssize_t ret = write(s_readyFd, &c, 1);
+    Q_UNUSED(ret);
+    close(s_readyFd);
+    s_readyFd = -1;
+}
+
+int Supervisor::supervise()
+{
+    if (!bindSocket())
+        fprintf(stderr, "grefsen supervisor: no socket; restarting without it, so clients will lose their connection on a crash\n");
+    // applications started by a compositor that crashed get reparented to us, not to init
+    prctl(PR_SET_CHILD_SUBREAPER, 1, 0, 0, 0);
+    signal(SIGPIPE, SIG_IGN);
+
+    qint64 crashTimes[MaxCrashesInWindow] = {};
+    int crashes = 0;
+    qint64 crashedAt = 0;
+    for (;;) {
+        int ready[2];
+        if (pipe2(ready, O_CLOEXEC) < 0)
+            return EXIT_FAILURE;
+        const qint64 startedAt = monotonicMs();
+        pid_t pid = fork();
+        if (pid < 0)
+            return EXIT_FAILURE;
+        if (pid == 0) {
+            close(ready[0]);
+            if (s_lockFd >= 0)
+                close(s_lockFd);
+            s_readyFd = ready[1];
+            s_supervised = true;
+            prctl(PR_SET_CHILD_SUBREAPER, 0, 0, 0, 0);
+            signal(SIGPIPE, SIG_DFL);
+            return -1;
+        }
+        close(ready[1]);
+
+        char c;
+        ssize_t n;
+        do {
+            n = read(ready[0], &c, 1);
+        } while (n < 0 && errno == EINTR);
+        close(ready[0]);
+        if (n == 1) {
+            const qint64 now = monotonicMs();
+            const char *socketName = s_socketName.isEmpty() ? "its own socket" : s_socketName.constData();
+            if (crashedAt)
+                fprintf(stderr, "grefsen supervisor: compositor %d listening on %s %lld ms after the crash (startup %lld ms)\n",
+                        pid, socketName, now - crashedAt, now - startedAt);
+            else
+                fprintf(stderr, "grefsen supervisor: compositor %d listening on %s\n", pid, socketName);
+        }
+
+        // reap orphaned clients along the way, until the compositor itself exits
+        int status = 0;
+        for (;;) {
+            pid_t exited = waitpid(-1, &status, 0);
+            if (exited == pid)
+                break;
+            if (exited < 0 && errno != EINTR) {
+                status = 0;
+                break;
+            }
+        }
+        crashedAt = monotonicMs();
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+            if (hasSocket()) {
+                unlink(s_socketPath.constData());
+                unlink(layoutFilePath().toLocal8Bit().constData());
+            }
+            return EXIT_SUCCESS;
+        }
+        if (WIFSIGNALED(status))
+            fprintf(stderr, "grefsen supervisor: compositor %d crashed (SIG %d), restarting\n", pid, WTERMSIG(status));
+        else
+            fprintf(stderr, "grefsen supervisor: compositor %d exited with %d, restarting\n", pid, WEXITSTATUS(status));
+
+        // give up if it keeps crashing right away
+        crashTimes[crashes++ % MaxCrashesInWindow] = crashedAt;
+        if (crashes >= MaxCrashesInWindow &&
+                crashedAt - crashTimes[crashes % MaxCrashesInWindow] < CrashWindow) {
+            fprintf(stderr, "grefsen supervisor: %d crashes within %d ms; giving up\n", MaxCrashesInWindow, CrashWindow);
+            if (hasSocket())
+                unlink(s_socketPath.constData());
+            return EXIT_FAILURE;
+        }
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
+#include <QByteArray>
+#include <QString>
+
+/*!
+    With --respawn, Grefsen starts as a small supervisor process, before
+    anything Qt is initialized. The supervisor binds the Wayland listening
+    socket (grefsen-0 in $XDG_RUNTIME_DIR, or the next free one) and then
+    forks the actual compositor, which adds the inherited socket to its
+    WaylandCompositor. When the compositor crashes, the supervisor forks a
+    new one right away: the socket stays open the whole time, so clients
+    that reconnect (Qt clients do, with QT_WAYLAND_RECONNECT=1) are queued
+    in its backlog rather than refused, and the window layout is restored
+    from the file that the previous compositor kept up to date (see
+    SessionLayout).
+
+    If no socket can be bound (e.g. XDG_RUNTIME_DIR is not set), the
+    supervisor still restarts crashed compositors, but each one makes its
+    own socket, so clients lose their connection and the layout is not
+    restored.
+
+    The supervisor is also the subreaper for the clients, so that
+    applications started from the crashed compositor aren't orphaned to
+    init.
+*/
+class Supervisor
+{
+public:
+    // returns the exit code in the supervisor, and -1 in the compositor
+    static int supervise();
+
+    static bool isSupervised() { return s_supervised; }
+    static bool hasSocket() { return s_socketFd >= 0; }
+    static int socketFd() { return s_socketFd; }
+    static QByteArray socketName() { return s_socketName; }
+    static QString layoutFilePath();
+    static void notifyReady();
+
+private:
+    static bool bindSocket();
+
+    static bool s_supervised;
+    static int s_socketFd;
+    static int s_lockFd;
+    static int s_readyFd;
+    static QByteArray s_socketName;
+    static QByteArray s_socketPath;
+};
+
+#endif // SUPERVISOR_H
@@ -0,0 +1,254 @@
+#include "surfaceviewtracker.h"
+
+#include <QLoggingCategory>
+#include <QMetaProperty>
+#include <QQmlContext>
+#include <QQmlEngine>
+#include <QScreen>
+
+Q_LOGGING_CATEGORY(lcViews, "grefsen.compositor.views")
+
+static QHash<QObject *, SurfaceViewTracker *> trackersBySurface;
+
+// the outputs and move items are QML objects; follow their properties by name
+static QMetaObject::Connection connectToUpdate(QObject *sender, const char *property, SurfaceViewTracker *tracker)
+{
+    const QMetaObject *mo = sender->metaObject();
+    int index = mo->indexOfProperty(property);
+    if (index < 0 || !mo->property(index).hasNotifySignal())
+        return QMetaObject::Connection();
+    static const QMetaMethod update = tracker->metaObject()->method(tracker->metaObject()->indexOfSlot("update()"));
+    return QObject::connect(sender, mo->property(index).notifySignal(), tracker, update);
+}
+
+SurfaceViewTracker::SurfaceViewTracker(QObject *parent)
+    : QObject(parent)
+{
+}
+
+SurfaceViewTracker::~SurfaceViewTracker()
+{
+    unregisterSurface();
+}
+
+// by the raw pointer it was inserted with: the surface may be gone already, and its address reused
+void SurfaceViewTracker::unregisterSurface()
+{
+    disconnect(m_surfaceConnection);
+    if (m_surface && trackersBySurface.value(m_surface) == this)
+        trackersBySurface.remove(m_surface);
+    m_surface = nullptr;
+}
+
+SurfaceViewTracker *SurfaceViewTracker::trackerFor(QObject *surface)
+{
+    return surface ? trackersBySurface.value(surface) : nullptr;
+}
+
+void SurfaceViewTracker::setDelegate(QQmlComponent *delegate)
+{
+    if (m_delegate == delegate)
+        return;
+    m_delegate = delegate;
+    emit delegateChanged();
+    update();
+}
+
+void SurfaceViewTracker::setShellSurface(QObject *shellSurface)
+{
+    if (m_shellSurface == shellSurface)
+        return;
+    if (m_shellSurface)
+        disconnect(m_shellSurface, nullptr, this, nullptr);
+    unregisterSurface();
+    m_shellSurface = shellSurface;
+    m_surface = shellSurface ? shellSurface->property("surface").value<QObject *>() : nullptr;
+    if (m_surface) {
+        trackersBySurface.insert(m_surface, this);
+        m_surfaceConnection = connect(m_surface, &QObject::destroyed, this, &SurfaceViewTracker::unregisterSurface);
+    }
+    if (shellSurface)
+        connect(shellSurface, &QObject::destroyed, this, &QObject::deleteLater);
+    emit shellSurfaceChanged();
+    update();
+}
+
+void SurfaceViewTracker::setTopLevel(QObject *topLevel)
+{
+    if (m_topLevel == topLevel)
+        return;
+    m_topLevel = topLevel;
+    emit topLevelChanged();
+}
+
+void SurfaceViewTracker::setMoveItem(QQuickItem *moveItem)
+{
+    if (m_moveItem == moveItem)
+        return;
+    for (const auto &c : qAsConst(m_moveItemConnections))
+        disconnect(c);
+    m_moveItemConnections.clear();
+    m_moveItem = moveItem;
+    if (moveItem) {
+        m_moveItemConnections << connect(moveItem, &QQuickItem::xChanged, this, &SurfaceViewTracker::update)
+                              << connect(moveItem, &QQuickItem::yChanged, this, &SurfaceViewTracker::update)
+                              << connect(moveItem, &QQuickItem::widthChanged, this, &SurfaceViewTracker::update)
+                              << connect(moveItem, &QQuickItem::heightChanged, this, &SurfaceViewTracker::update)
+                              << connectToUpdate(moveItem, "moving", this);
+    }
+    emit moveItemChanged();
+    update();
+}
+
+void SurfaceViewTracker::setDecorate(bool decorate)
+{
+    if (m_decorate == decorate)
+        return;
+    m_decorate = decorate;
+    emit decorateChanged();
+}
+
+void SurfaceViewTracker::setOutputs(const QList<QObject *> &outputs)
+{
+    if (m_outputs == outputs)
+        return;
+    for (const auto &c : qAsConst(m_outputConnections))
+        disconnect(c);
+    m_outputConnections.clear();
+    m_outputs = outputs;
+    for (QObject *output : outputs) {
+        m_outputConnections << connectToUpdate(output, "geometry", this);
+        m_outputConnections << connect(output, &QObject::destroyed, this, [this, output]() {
+            m_outputs.removeAll(output);
+            m_views.remove(output);
+            emit viewsChanged();
+        });
+    }
+    emit outputsChanged();
+    update();
+}
+
+QQuickItem *SurfaceViewTracker::viewOn(QObject *output) const
+{
+    return m_views.value(output);
+}
+
+QList<QQuickItem *> SurfaceViewTracker::views() const
+{
+    QList<QQuickItem *> ret;
+    for (const QPointer<QQuickItem> &view : m_views)
+        if (view)
+            ret << view;
+    return ret;
+}
+
+void SurfaceViewTracker::componentComplete()
+{
+    m_complete = true;
+    update();
+}
+
+// the frame around the surface is whatever the delegate (Chrome.qml) makes it: none when fullscreen,
+// thinner for popups; before there is a view, the surface alone will do
+QRectF SurfaceViewTracker::windowRect() const
+{
+    QRectF ret(m_moveItem->x(), m_moveItem->y(), m_moveItem->width(), m_moveItem->height());
+    if (ret.isEmpty() || !m_decorate)
+        return ret;
+    for (const QPointer<QQuickItem> &view : m_views) {
+        if (!view)
+            continue;
+        const qreal margin = view->property("marginWidth").toReal();
+        ret.adjust(0, 0, 2 * margin, margin + view->property("titlebarHeight").toReal());
+        break;
+    }
+    return ret;
+}
+
+bool SurfaceViewTracker::intersects(QObject *output, const QRectF &rect)
+{
+    const QRectF geometry = output->property("geometry").toRect();
+    // no buffer yet: only the position is known
+    if (rect.isEmpty())
+        return geometry.contains(rect.topLeft());
+    return geometry.intersects(rect);
+}
+
+void SurfaceViewTracker::update()
+{
+    if (!m_complete || !m_delegate || !m_shellSurface || !m_moveItem || m_outputs.isEmpty())
+        return;
+
+    const QRectF rect = windowRect();
+    QList<QObject *> wanted;
+    for (QObject *output : qAsConst(m_outputs))
+        if (intersects(output, rect))
+            wanted << output;
+    // a window that has been moved off all outputs stays where it was last seen
+    if (wanted.isEmpty()) {
+        for (auto it = m_views.constBegin(); it != m_views.constEnd(); ++it)
+            if (it.value())
+                return;
+        wanted << m_outputs.first();
+    }
+
+    const bool moving = m_moveItem->property("moving").toBool();
+    bool changed = false;
+    for (QObject *output : qAsConst(m_outputs)) {
+        if (wanted.contains(output)) {
+            if (!m_views.value(output) && createView(output))
+                changed = true;
+        } else if (m_views.contains(output) && !moving) {
+            removeView(output);
+            changed = true;
+        }
+    }
+    if (changed)
+        emit viewsChanged();
+}
+
+QQuickItem *SurfaceViewTracker::createView(QObject *output)
+{
+    QQuickItem *parentView = nullptr;
+    if (SurfaceViewTracker *parentTracker = trackerFor(m_shellSurface->property("parentSurface").value<QObject *>()))
+        parentView = parentTracker->viewOn(output);
+    QQuickItem *parent = parentView ? parentView : output->property("surfaceArea").value<QQuickItem *>();
+    QScreen *screen = output->property("targetScreen").value<QScreen *>();
+
+    QVariantMap properties;
+    properties.insert(QStringLiteral("shellSurface"), QVariant::fromValue(m_shellSurface.data()));
+    properties.insert(QStringLiteral("topLevel"), QVariant::fromValue(m_topLevel.data()));
+    properties.insert(QStringLiteral("moveItem"), QVariant::fromValue(m_moveItem.data()));
+    properties.insert(QStringLiteral("screenName"), screen ? screen->name() : QString());
+    properties.insert(QStringLiteral("decorationVisible"), m_decorate);
+    QObject *obj = m_delegate->createWithInitialProperties(properties, m_delegate->creationContext());
+    QQuickItem *view = qobject_cast<QQuickItem *>(obj);
+    if (!view) {
+        qWarning() << "failed to create view of" << m_shellSurface << m_delegate->errors();
+        delete obj;
+        return nullptr;
+    }
+    // owned by the parent item, but the view may destroy() itself after its animation
+    view->setParent(parent);
+    view->setParentItem(parent);
+    QQmlEngine::setObjectOwnership(view, QQmlEngine::JavaScriptOwnership);
+    if (parentView) {
+        const QPointF position = output->property("position").toPointF();
+        view->setX(view->x() + position.x());
+        view->setY(view->y() + position.y());
+    }
+    m_views.insert(output, view);
+    qCDebug(lcViews) << "created view of" << m_shellSurface << "on" << output << (screen ? screen->name() : QString())
+                     << "parent view" << parentView;
+    emit viewCreated(view, output);
+    return view;
+}
+
+void SurfaceViewTracker::removeView(QObject *output)
+{
+    QPointer<QQuickItem> view = m_views.take(output);
+    qCDebug(lcViews) << "removed view of" << m_shellSurface << "from" << output;
+    if (view)
+        view->deleteLater();
+    emit viewRemoved(output);
+}
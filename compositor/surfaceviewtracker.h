@@ -0,0 +1,98 @@
+#ifndef SURFACEVIEWTRACKER_H
+#define SURFACEVIEWTRACKER_H
+
+#include <QHash>
+#include <QPointer>
+#include <QQmlComponent>
+#include <QQmlParserStatus>
+#include <QQuickItem>
+
+/*!
+    Keeps one view (a Chrome instance) of a shell surface on each output
+    that the surface's moveItem intersects, and none on the others.
+
+    Views are created from \c delegate as soon as the moveItem overlaps an
+    output, and destroyed when it no longer does; while the window is being
+    moved, destruction is postponed until the move is over, so that a view
+    doesn't vanish from under the pointer that is dragging it. A surface
+    without a buffer yet has an empty geometry; its position alone decides
+    which output it appears on.
+
+    The tracker deletes itself when the shell surface is destroyed; the
+    views then run their own destroy animations.
+*/
+class SurfaceViewTracker : public QObject, public QQmlParserStatus
+{
+    Q_OBJECT
+    Q_INTERFACES(QQmlParserStatus)
+    Q_PROPERTY(QQmlComponent *delegate READ delegate WRITE setDelegate NOTIFY delegateChanged)
+    Q_PROPERTY(QObject *shellSurface READ shellSurface WRITE setShellSurface NOTIFY shellSurfaceChanged)
+    Q_PROPERTY(QObject *topLevel READ topLevel WRITE setTopLevel NOTIFY topLevelChanged)
+    Q_PROPERTY(QQuickItem *moveItem READ moveItem WRITE setMoveItem NOTIFY moveItemChanged)
+    Q_PROPERTY(bool decorate READ decorate WRITE setDecorate NOTIFY decorateChanged)
+    Q_PROPERTY(QList<QObject *> outputs READ outputs WRITE setOutputs NOTIFY outputsChanged)
+    Q_PROPERTY(int viewCount READ viewCount NOTIFY viewsChanged)
+
+public:
+    explicit SurfaceViewTracker(QObject *parent = nullptr);
+    ~SurfaceViewTracker();
+
+    QQmlComponent *delegate() const { return m_delegate; }
+    void setDelegate(QQmlComponent *delegate);
+    QObject *shellSurface() const { return m_shellSurface; }
+    void setShellSurface(QObject *shellSurface);
+    QObject *topLevel() const { return m_topLevel; }
+    void setTopLevel(QObject *topLevel);
+    QQuickItem *moveItem() const { return m_moveItem; }
+    void setMoveItem(QQuickItem *moveItem);
+    bool decorate() const { return m_decorate; }
+    void setDecorate(bool decorate);
+    QList<QObject *> outputs() const { return m_outputs; }
+    void setOutputs(const QList<QObject *> &outputs);
+
+    int viewCount() const { return m_views.count(); }
+    Q_INVOKABLE QQuickItem *viewOn(QObject *output) const;
+    QList<QQuickItem *> views() const;
+
+    static SurfaceViewTracker *trackerFor(QObject *surface);
+
+signals:
+    void delegateChanged();
+    void shellSurfaceChanged();
+    void topLevelChanged();
+    void moveItemChanged();
+    void decorateChanged();
+    void outputsChanged();
+    void viewsChanged();
+    void viewCreated(QQuickItem *view, QObject *output);
+    void viewRemoved(QObject *output);
+
+public slots:
+    void update();
+
+protected:
+    void classBegin() override { }
+    void componentComplete() override;
+
+    QRectF windowRect() const;
+    static bool intersects(QObject *output, const QRectF &rect);
+    QQuickItem *createView(QObject *output);
+    void removeView(QObject *output);
+    void unregisterSurface();
+
+protected:
+    QPointer<QQmlComponent> m_delegate;
+    QPointer<QObject> m_shellSurface;
+    QObject *m_surface = nullptr; // only the key in trackersBySurface; not to be dereferenced
+    QMetaObject::Connection m_surfaceConnection;
+    QPointer<QObject> m_topLevel;
+    QPointer<QQuickItem> m_moveItem;
+    bool m_decorate = true;
+    QList<QObject *> m_outputs;
+    QHash<QObject *, QPointer<QQuickItem> > m_views;
+    QList<QMetaObject::Connection> m_outputConnections;
+    QList<QMetaObject::Connection> m_moveItemConnections;
+    bool m_complete = false;
+};
+
+#endif // SURFACEVIEWTRACKER_H
@@ -0,0 +1,277 @@
+#include "thumbnailcache.h"
+#include "surfaceviewtracker.h"
+
+#include <QLoggingCategory>
+#include <QMutexLocker>
+#include <QPointer>
+#include <QQuickImageProvider>
+#include <QQuickItem>
+#include <QQuickItemGrabResult>
+#include <QSettings>
+#include <QtWaylandCompositor/QWaylandBufferRef>
+#include <QtWaylandCompositor/QWaylandSurface>
+#include <QtWaylandCompositor/QWaylandView>
+
+Q_LOGGING_CATEGORY(lcThumbnails, "grefsen.compositor.thumbnails")
+
+static const int RefreshInterval = 50; // ms
+static const int RefreshesPerTick = 4;
+
+class ThumbnailProvider : public QQuickImageProvider
+{
+public:
+    explicit ThumbnailProvider(ThumbnailCache *cache)
+        : QQuickImageProvider(QQuickImageProvider::Image)
+        , m_cache(cache)
+    {
+    }
+
+    // the id is <thumbnail id>/<serial>; the serial only makes the URL change
+    QImage requestImage(const QString &id, QSize *size, const QSize &requestedSize) override
+    {
+        Q_UNUSED(requestedSize);
+        const QImage ret = m_cache ? m_cache->image(id.section(QLatin1Char('/'), 0, 0).toInt()) : QImage();
+        if (size)
+            *size = ret.size();
+        return ret;
+    }
+
+protected:
+    QPointer<ThumbnailCache> m_cache;
+};
+
+ThumbnailCache::ThumbnailCache(QObject *parent)
+    : QObject(parent)
+{
+    QSettings settings;
+    settings.beginGroup(QStringLiteral("switcher"));
+    m_thumbnailSize = qMax(16, settings.value(QStringLiteral("thumbnailSize"), m_thumbnailSize).toInt());
+    m_budget = qMax(1, settings.value(QStringLiteral("thumbnailBudget"), 16).toInt()) * 1024 * 1024;
+
+    m_pool.setMaxThreadCount(1);
+    m_timer.setInterval(RefreshInterval);
+    connect(&m_timer, &QTimer::timeout, this, &ThumbnailCache::refreshSome);
+}
+
+ThumbnailCache::~ThumbnailCache()
+{
+    // scaling jobs refer to this
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+QQuickImageProvider *ThumbnailCache::imageProvider()
+{
+    return new ThumbnailProvider(this);
+}
+
+QImage ThumbnailCache::image(int id) const
+{
+    QMutexLocker lock(&m_imagesMutex);
+    return m_images.value(id);
+}
+
+void ThumbnailCache::setActive(bool active)
+{
+    if (m_active == active)
+        return;
+    m_active = active;
+    if (active) {
+        m_activeSince = m_useCounter;
+        for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+            if (it->dirty)
+                enqueue(it.key(), *it);
+    } else {
+        m_queue.clear();
+        for (Entry &entry : m_entries)
+            entry.queued = false;
+        m_timer.stop();
+        // what the switcher was showing may be over the budget
+        evict(0);
+    }
+    emit activeChanged();
+}
+
+QUrl ThumbnailCache::url(QObject *shellSurface)
+{
+    QWaylandSurface *surface = shellSurface ? shellSurface->property("surface").value<QWaylandSurface *>() : nullptr;
+    Entry *e = entry(surface);
+    if (!e)
+        return QUrl();
+    e->lastUsed = ++m_useCounter;
+    if (m_active && e->dirty)
+        enqueue(surface, *e);
+    return QUrl(QStringLiteral("image://thumbnails/%1/%2").arg(e->id).arg(e->serial));
+}
+
+ThumbnailCache::Entry *ThumbnailCache::entry(QWaylandSurface *surface)
+{
+    if (!surface)
+        return nullptr;
+    auto it = m_entries.find(surface);
+    if (it != m_entries.end())
+        return &*it;
+    Entry e;
+    e.id = m_nextId++;
+    m_surfaces.insert(e.id, surface);
+    connect(surface, &QWaylandSurface::redraw, this, [this, surface]() { contentChanged(surface); });
+    connect(surface, &QObject::destroyed, this, [this, surface]() { forget(surface); });
+    return &*m_entries.insert(surface, e);
+}
+
+void ThumbnailCache::forget(QWaylandSurface *surface)
+{
+    auto it = m_entries.find(surface);
+    if (it == m_entries.end())
+        return;
+    const int id = it->id;
+    m_entries.erase(it);
+    m_surfaces.remove(id);
+    m_queue.removeAll(surface);
+    drop(id);
+    emit revisionChanged();
+}
+
+void ThumbnailCache::contentChanged(QWaylandSurface *surface)
+{
+    auto it = m_entries.find(surface);
+    if (it == m_entries.end())
+        return;
+    it->dirty = true;
+    if (m_active)
+        enqueue(surface, *it);
+}
+
+void ThumbnailCache::enqueue(QWaylandSurface *surface, Entry &entry)
+{
+    if (entry.queued)
+        return;
+    entry.queued = true;
+    m_queue.append(surface);
+    if (!m_timer.isActive())
+        m_timer.start();
+}
+
+void ThumbnailCache::refreshSome()
+{
+    for (int i = 0; i < RefreshesPerTick && !m_queue.isEmpty(); ++i)
+        refresh(m_queue.takeFirst());
+    if (m_queue.isEmpty())
+        m_timer.stop();
+}
+
+void ThumbnailCache::refresh(QWaylandSurface *surface)
+{
+    auto it = m_entries.find(surface);
+    if (it == m_entries.end())
+        return;
+    it->queued = false;
+    it->dirty = false;
+    const int id = it->id;
+
+    QWaylandView *view = surface->primaryView();
+    if (!view && !surface->views().isEmpty())
+        view = surface->views().first();
+    const QWaylandBufferRef buffer = view ? view->currentBuffer() : QWaylandBufferRef();
+    if (buffer.isSharedMemory()) {
+        const QImage image = buffer.image();
+        const QSize size = thumbnailSize(image.size());
+        if (size.isEmpty())
+            return;
+        // read only as many pixels as needed from the client's buffer, while we still hold it;
+        // the smooth scaling of our own copy can wait for another thread
+        const QImage sample = image.scaled((size * 2).boundedTo(image.size()), Qt::IgnoreAspectRatio, Qt::FastTransformation);
+        m_pool.start([this, id, size, sample]() {
+            const QImage thumbnail = sample.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation)
+                    .convertToFormat(QImage::Format_ARGB32_Premultiplied);
+            QMetaObject::invokeMethod(this, [this, id, thumbnail]() { store(id, thumbnail); }, Qt::QueuedConnection);
+        });
+        return;
+    }
+
+    // a texture: render a view of it, at thumbnail size
+    SurfaceViewTracker *tracker = SurfaceViewTracker::trackerFor(surface);
+    const QList<QQuickItem *> views = tracker ? tracker->views() : QList<QQuickItem *>();
+    for (QQuickItem *v : views) {
+        QQuickItem *item = v->property("shellSurfaceItem").value<QQuickItem *>();
+        if (!item || !item->isVisible() || !item->window())
+            continue;
+        const QSize size = thumbnailSize(item->size().toSize());
+        if (size.isEmpty())
+            continue;
+        QSharedPointer<QQuickItemGrabResult> result = item->grabToImage(size);
+        if (!result)
+            continue;
+        connect(result.data(), &QQuickItemGrabResult::ready, this, [this, id, result]() {
+            store(id, result->image().convertToFormat(QImage::Format_ARGB32_Premultiplied));
+        }, Qt::SingleShotConnection);
+        return;
+    }
+    // not shown anywhere just now (covered by other windows, perhaps): keep the old one
+    qCDebug(lcThumbnails) << "can't make a thumbnail of" << surface << "for now";
+    it->dirty = true;
+}
+
+void ThumbnailCache::store(int id, const QImage &image)
+{
+    QWaylandSurface *surface = m_surfaces.value(id);
+    if (!surface || image.isNull())
+        return;
+    {
+        QMutexLocker lock(&m_imagesMutex);
+        const QImage old = m_images.value(id);
+        if (old.isNull())
+            ++m_imageCount;
+        m_bytesUsed += image.sizeInBytes() - old.sizeInBytes();
+        m_images.insert(id, image);
+    }
+    ++m_entries[surface].serial;
+    evict(id);
+    qCDebug(lcThumbnails) << "thumbnail" << id << image.size() << "of" << surface << "; using" << m_bytesUsed << "bytes";
+    ++m_revision;
+    emit revisionChanged();
+}
+
+void ThumbnailCache::drop(int id)
+{
+    QMutexLocker lock(&m_imagesMutex);
+    auto it = m_images.find(id);
+    if (it == m_images.end())
+        return;
+    m_bytesUsed -= it->sizeInBytes();
+    --m_imageCount;
+    m_images.erase(it);
+}
+
+// the least recently used ones go first; those on screen not at all
+void ThumbnailCache::evict(int keepId)
+{
+    while (m_bytesUsed > m_budget) {
+        QWaylandSurface *oldest = nullptr;
+        quint64 oldestUse = 0;
+        for (auto it = m_entries.constBegin(); it != m_entries.constEnd(); ++it) {
+            if (it->id == keepId || !m_images.contains(it->id) || (m_active && it->lastUsed > m_activeSince))
+                continue;
+            if (!oldest || it->lastUsed < oldestUse) {
+                oldest = it.key();
+                oldestUse = it->lastUsed;
+            }
+        }
+        if (!oldest)
+            return;
+        Entry &e = m_entries[oldest];
+        drop(e.id);
+        ++e.serial;
+        e.dirty = true;
+    }
+}
+
+// fits in a square, and is never bigger than the window
+QSize ThumbnailCache::thumbnailSize(const QSize &size) const
+{
+    if (size.isEmpty())
+        return QSize();
+    if (size.width() <= m_thumbnailSize && size.height() <= m_thumbnailSize)
+        return size;
+    return size.scaled(m_thumbnailSize, m_thumbnailSize, Qt::KeepAspectRatio);
+}
@@ -0,0 +1,108 @@
+#ifndef THUMBNAILCACHE_H
+#define THUMBNAILCACHE_H
+
+#include <QHash>
+#include <QImage>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QThreadPool>
+#include <QTimer>
+#include <QUrl>
+
+class QQuickImageProvider;
+class QWaylandSurface;
+
+/*!
+    Small pictures of windows, for the WindowSwitcher: \c url() returns an
+    image://thumbnails/ URL for a shell surface, which changes whenever
+    there is a newer picture.
+
+    A thumbnail is only made again when the client has committed new
+    content since the last one, and only while the cache is \c active (the
+    switcher is open), a few per tick, so opening the switcher only costs
+    showing the pictures that are already there. Shared-memory buffers are
+    sampled down on the GUI thread and then scaled smoothly on a worker
+    thread; others (EGL, dmabuf) are rendered at thumbnail size with
+    QQuickItem::grabToImage(), from a view that is visible. The least
+    recently used thumbnails are dropped to stay within the memory budget,
+    but not those shown since the switcher opened: they would only be made
+    again at once. Until it closes, the budget may be exceeded instead.
+
+    \code
+    [switcher]
+    thumbnailSize=256
+    thumbnailBudget=16
+    \endcode
+
+    The size is the longer side in pixels; the budget is in MiB.
+*/
+class ThumbnailCache : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(bool active READ isActive WRITE setActive NOTIFY activeChanged)
+    Q_PROPERTY(int revision READ revision NOTIFY revisionChanged)
+    Q_PROPERTY(int count READ count NOTIFY revisionChanged)
+    Q_PROPERTY(qint64 bytesUsed READ bytesUsed NOTIFY revisionChanged)
+
+public:
+    explicit ThumbnailCache(QObject *parent = nullptr);
+    ~ThumbnailCache() override;
+
+    bool isActive() const { return m_active; }
+    void setActive(bool active);
+    int revision() const { return m_revision; }
+    int count() const { return m_imageCount; }
+    qint64 bytesUsed() const { return m_bytesUsed; }
+
+    // bind to revision as well, to get the newer URL
+    Q_INVOKABLE QUrl url(QObject *shellSurface);
+
+    // for the engine, which takes ownership
+    QQuickImageProvider *imageProvider();
+    QImage image(int id) const;
+
+signals:
+    void activeChanged();
+    void revisionChanged();
+
+protected:
+    struct Entry {
+        int id = 0;
+        int serial = 0;
+        bool dirty = true;
+        bool queued = false;
+        quint64 lastUsed = 0;
+    };
+
+    Entry *entry(QWaylandSurface *surface);
+    void forget(QWaylandSurface *surface);
+    void contentChanged(QWaylandSurface *surface);
+    void enqueue(QWaylandSurface *surface, Entry &entry);
+    void refreshSome();
+    void refresh(QWaylandSurface *surface);
+    void store(int id, const QImage &image);
+    void drop(int id);
+    void evict(int keepId);
+    QSize thumbnailSize(const QSize &size) const;
+
+protected:
+    QHash<QWaylandSurface *, Entry> m_entries;
+    QHash<int, QWaylandSurface *> m_surfaces;
+    QList<QWaylandSurface *> m_queue;
+    mutable QMutex m_imagesMutex; // m_images is read by the image provider
+    QHash<int, QImage> m_images;
+    QThreadPool m_pool;
+    QTimer m_timer;
+    int m_thumbnailSize = 256;
+    qint64 m_budget = 16 * 1024 * 1024;
+    qint64 m_bytesUsed = 0;
+    int m_imageCount = 0;
+    int m_nextId = 1;
+    int m_revision = 0;
+    quint64 m_useCounter = 0;
+    quint64 m_activeSince = 0; // entries used after this are on screen
+    bool m_active = false;
+};
+
+#endif // THUMBNAILCACHE_H
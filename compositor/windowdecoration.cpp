@@ -0,0 +1,225 @@
+#include "windowdecoration.h"
+
+#include <QCursor>
+#include <QSGGeometryNode>
+#include <QSGVertexColorMaterial>
+#include <QtMath>
+
+static const int GlowSegments = 16;
+
+static void setVertex(QSGGeometry::ColoredPoint2D &v, qreal x, qreal y, const QColor &c)
+{
+    // QSGVertexColorMaterial expects premultiplied colors
+    const int a = c.alpha();
+    v.set(float(x), float(y), uchar(c.red() * a / 255), uchar(c.green() * a / 255), uchar(c.blue() * a / 255), uchar(a));
+}
+
+static void addQuad(QVector<QSGGeometry::ColoredPoint2D> &v, const QRectF &r, const QColor &top, const QColor &bottom)
+{
+    if (r.isEmpty())
+        return;
+    QSGGeometry::ColoredPoint2D p[4];
+    setVertex(p[0], r.left(), r.top(), top);
+    setVertex(p[1], r.right(), r.top(), top);
+    setVertex(p[2], r.left(), r.bottom(), bottom);
+    setVertex(p[3], r.right(), r.bottom(), bottom);
+    v << p[0] << p[1] << p[2] << p[1] << p[3] << p[2];
+}
+
+WindowDecoration::WindowDecoration(QQuickItem *parent)
+    : QQuickItem(parent)
+{
+    setFlag(ItemHasContents);
+    setAcceptHoverEvents(true);
+    setAcceptedMouseButtons(Qt::LeftButton);
+    connect(this, &WindowDecoration::appearanceChanged, this, &QQuickItem::update);
+}
+
+#define DECORATION_SETTER(Type, setter, member) \
+void WindowDecoration::setter(Type value) \
+{ \
+    if (member == value) \
+        return; \
+    member = value; \
+    emit appearanceChanged(); \
+}
+
+DECORATION_SETTER(const QColor &, setColor, m_color)
+DECORATION_SETTER(const QColor &, setBorderColor, m_borderColor)
+DECORATION_SETTER(qreal, setMarginWidth, m_marginWidth)
+DECORATION_SETTER(qreal, setTitlebarHeight, m_titlebarHeight)
+DECORATION_SETTER(const QColor &, setTitlebarTopColor, m_titlebarTopColor)
+DECORATION_SETTER(const QColor &, setTitlebarBottomColor, m_titlebarBottomColor)
+DECORATION_SETTER(const QPointF &, setCloseGlowCenter, m_closeGlowCenter)
+DECORATION_SETTER(qreal, setCloseGlowRadius, m_closeGlowRadius)
+DECORATION_SETTER(const QColor &, setCloseGlowColor, m_closeGlowColor)
+
+#undef DECORATION_SETTER
+
+void WindowDecoration::setResizeAreaWidth(qreal width)
+{
+    if (m_resizeAreaWidth == width)
+        return;
+    m_resizeAreaWidth = width;
+    emit resizeAreaWidthChanged();
+}
+
+QSGNode *WindowDecoration::updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *)
+{
+    QSGGeometryNode *node = static_cast<QSGGeometryNode *>(oldNode);
+    if (!node) {
+        node = new QSGGeometryNode;
+        QSGGeometry *geometry = new QSGGeometry(QSGGeometry::defaultAttributes_ColoredPoint2D(), 0);
+        geometry->setDrawingMode(QSGGeometry::DrawTriangles);
+        node->setGeometry(geometry);
+        node->setFlag(QSGNode::OwnsGeometry);
+        node->setMaterial(new QSGVertexColorMaterial);
+        node->setFlag(QSGNode::OwnsMaterial);
+    }
+
+    const QRectF r = boundingRect();
+    QVector<QSGGeometry::ColoredPoint2D> v;
+    v.reserve(6 * 6 + GlowSegments * 3);
+    addQuad(v, r, m_color, m_color);
+    // 1px border
+    addQuad(v, QRectF(r.left(), r.top(), r.width(), 1), m_borderColor, m_borderColor);
+    addQuad(v, QRectF(r.left(), r.bottom() - 1, r.width(), 1), m_borderColor, m_borderColor);
+    addQuad(v, QRectF(r.left(), r.top() + 1, 1, r.height() - 2), m_borderColor, m_borderColor);
+    addQuad(v, QRectF(r.right() - 1, r.top() + 1, 1, r.height() - 2), m_borderColor, m_borderColor);
+    // titlebar gradient
+    if (m_titlebarHeight > m_marginWidth)
+        addQuad(v, QRectF(m_marginWidth, m_marginWidth, r.width() - 2 * m_marginWidth, m_titlebarHeight - m_marginWidth),
+                m_titlebarTopColor, m_titlebarBottomColor);
+    // close button glow: a fan fading out from the center
+    if (m_closeGlowColor.alpha() > 0 && m_closeGlowRadius > 0) {
+        QColor edge = m_closeGlowColor;
+        edge.setAlpha(0);
+        for (int i = 0; i < GlowSegments; ++i) {
+            qreal a0 = 2 * M_PI * i / GlowSegments;
+            qreal a1 = 2 * M_PI * (i + 1) / GlowSegments;
+            QSGGeometry::ColoredPoint2D p[3];
+            setVertex(p[0], m_closeGlowCenter.x(), m_closeGlowCenter.y(), m_closeGlowColor);
+            setVertex(p[1], m_closeGlowCenter.x() + m_closeGlowRadius * qCos(a0),
+                      m_closeGlowCenter.y() + m_closeGlowRadius * qSin(a0), edge);
+            setVertex(p[2], m_closeGlowCenter.x() + m_closeGlowRadius * qCos(a1),
+                      m_closeGlowCenter.y() + m_closeGlowRadius * qSin(a1), edge);
+            v << p[0] << p[1] << p[2];
+        }
+    }
+
+    QSGGeometry *geometry = node->geometry();
+    geometry->allocate(v.count());
+    memcpy(geometry->vertexDataAsColoredPoint2D(), v.constData(), v.count() * sizeof(QSGGeometry::ColoredPoint2D));
+    node->markDirty(QSGNode::DirtyGeometry);
+    return node;
+}
+
+bool WindowDecoration::contains(const QPointF &point) const
+{
+    // the resize areas straddle the right and bottom edges
+    const qreal outside = m_resizeAreaWidth / 2;
+    return QRectF(0, 0, width() + outside, height() + outside).contains(point);
+}
+
+Qt::Edges WindowDecoration::edgesAt(const QPointF &pos) const
+{
+    Qt::Edges ret;
+    const qreal half = m_resizeAreaWidth / 2;
+    if (qAbs(pos.x() - width()) <= half && pos.y() <= height() + half)
+        ret |= Qt::RightEdge;
+    if (qAbs(pos.y() - height()) <= half && pos.x() <= width() + half)
+        ret |= Qt::BottomEdge;
+    return ret;
+}
+
+void WindowDecoration::setHoveredEdges(Qt::Edges edges)
+{
+    if (m_hoveredEdges == edges)
+        return;
+    m_hoveredEdges = edges;
+    // problem: this so far only sets the EGLFS cursor, not WaylandCursorItem
+    if (edges == (Qt::RightEdge | Qt::BottomEdge))
+        setCursor(Qt::SizeFDiagCursor);
+    else if (edges == Qt::RightEdge)
+        setCursor(Qt::SizeHorCursor);
+    else if (edges == Qt::BottomEdge)
+        setCursor(Qt::SizeVerCursor);
+    else
+        unsetCursor();
+    emit hoveredEdgesChanged();
+}
+
+void WindowDecoration::hoverEnterEvent(QHoverEvent *event)
+{
+    setHoveredEdges(edgesAt(event->position()));
+}
+
+void WindowDecoration::hoverMoveEvent(QHoverEvent *event)
+{
+    if (!resizing())
+        setHoveredEdges(edgesAt(event->position()));
+}
+
+void WindowDecoration::hoverLeaveEvent(QHoverEvent *)
+{
+    if (!resizing())
+        setHoveredEdges(Qt::Edges());
+}
+
+void WindowDecoration::mousePressEvent(QMouseEvent *event)
+{
+    Qt::Edges edges = edgesAt(event->position());
+    if (!edges) {
+        event->ignore();
+        return;
+    }
+    m_resizeEdges = edges;
+    m_pressScenePos = event->scenePosition();
+    emit resizingChanged();
+    emit resizeStarted(edges);
+}
+
+void WindowDecoration::mouseMoveEvent(QMouseEvent *event)
+{
+    if (!resizing())
+        return;
+    // the latest position is reported in updatePolish(), before the next frame
+    m_resizeScenePos = event->scenePosition();
+    if (!m_resizeUpdatePending) {
+        m_resizeUpdatePending = true;
+        polish();
+    }
+}
+
+void WindowDecoration::updatePolish()
+{
+    if (!m_resizeUpdatePending)
+        return;
+    m_resizeUpdatePending = false;
+    if (resizing())
+        emit resizeUpdated(m_resizeEdges, m_resizeScenePos - m_pressScenePos);
+}
+
+void WindowDecoration::mouseReleaseEvent(QMouseEvent *event)
+{
+    m_resizeUpdatePending = false;
+    if (resizing())
+        emit resizeUpdated(m_resizeEdges, event->scenePosition() - m_pressScenePos);
+    finishResize();
+    setHoveredEdges(edgesAt(event->position()));
+}
+
+void WindowDecoration::mouseUngrabEvent()
+{
+    finishResize();
+}
+
+void WindowDecoration::finishResize()
+{
+    m_resizeUpdatePending = false;
+    if (!resizing())
+        return;
+    m_resizeEdges = Qt::Edges();
+    emit resizingChanged();
+    emit resizeFinished();
+}
@@ -0,0 +1,107 @@
+#ifndef WINDOWDECORATION_H
+#define WINDOWDECORATION_H
+
+#include <QColor>
+#include <QQuickItem>
+
+/*!
+    Server-side window decoration: frame, titlebar gradient and the glow
+    behind the close button, all drawn as one vertex-colored geometry node,
+    without any shader effects or offscreen layers.
+
+    It also takes care of interactive resizing: the right and bottom edges
+    and the bottom-right corner (a band of resizeAreaWidth centered on the
+    edge, so it reaches outside the item) are hit-tested here, with the
+    appropriate cursor shape. While dragging, resizeUpdated() reports the
+    translation since the press: at most once per frame, however fast the
+    mouse reports motion, so that the client gets at most one configure
+    event per frame.
+*/
+class WindowDecoration : public QQuickItem
+{
+    Q_OBJECT
+    Q_PROPERTY(QColor color READ color WRITE setColor NOTIFY appearanceChanged)
+    Q_PROPERTY(QColor borderColor READ borderColor WRITE setBorderColor NOTIFY appearanceChanged)
+    Q_PROPERTY(qreal marginWidth READ marginWidth WRITE setMarginWidth NOTIFY appearanceChanged)
+    Q_PROPERTY(qreal titlebarHeight READ titlebarHeight WRITE setTitlebarHeight NOTIFY appearanceChanged)
+    Q_PROPERTY(QColor titlebarTopColor READ titlebarTopColor WRITE setTitlebarTopColor NOTIFY appearanceChanged)
+    Q_PROPERTY(QColor titlebarBottomColor READ titlebarBottomColor WRITE setTitlebarBottomColor NOTIFY appearanceChanged)
+    Q_PROPERTY(QPointF closeGlowCenter READ closeGlowCenter WRITE setCloseGlowCenter NOTIFY appearanceChanged)
+    Q_PROPERTY(qreal closeGlowRadius READ closeGlowRadius WRITE setCloseGlowRadius NOTIFY appearanceChanged)
+    Q_PROPERTY(QColor closeGlowColor READ closeGlowColor WRITE setCloseGlowColor NOTIFY appearanceChanged)
+    Q_PROPERTY(qreal resizeAreaWidth READ resizeAreaWidth WRITE setResizeAreaWidth NOTIFY resizeAreaWidthChanged)
+    Q_PROPERTY(Qt::Edges hoveredEdges READ hoveredEdges NOTIFY hoveredEdgesChanged)
+    Q_PROPERTY(bool resizing READ resizing NOTIFY resizingChanged)
+
+public:
+    WindowDecoration(QQuickItem *parent = nullptr);
+
+    QColor color() const { return m_color; }
+    void setColor(const QColor &color);
+    QColor borderColor() const { return m_borderColor; }
+    void setBorderColor(const QColor &color);
+    qreal marginWidth() const { return m_marginWidth; }
+    void setMarginWidth(qreal width);
+    qreal titlebarHeight() const { return m_titlebarHeight; }
+    void setTitlebarHeight(qreal height);
+    QColor titlebarTopColor() const { return m_titlebarTopColor; }
+    void setTitlebarTopColor(const QColor &color);
+    QColor titlebarBottomColor() const { return m_titlebarBottomColor; }
+    void setTitlebarBottomColor(const QColor &color);
+    QPointF closeGlowCenter() const { return m_closeGlowCenter; }
+    void setCloseGlowCenter(const QPointF &center);
+    qreal closeGlowRadius() const { return m_closeGlowRadius; }
+    void setCloseGlowRadius(qreal radius);
+    QColor closeGlowColor() const { return m_closeGlowColor; }
+    void setCloseGlowColor(const QColor &color);
+    qreal resizeAreaWidth() const { return m_resizeAreaWidth; }
+    void setResizeAreaWidth(qreal width);
+
+    Qt::Edges hoveredEdges() const { return m_hoveredEdges; }
+    bool resizing() const { return !!m_resizeEdges; }
+
+    bool contains(const QPointF &point) const override;
+
+signals:
+    void appearanceChanged();
+    void resizeAreaWidthChanged();
+    void hoveredEdgesChanged();
+    void resizingChanged();
+    void resizeStarted(Qt::Edges edges);
+    void resizeUpdated(Qt::Edges edges, QPointF translation);
+    void resizeFinished();
+
+protected:
+    QSGNode *updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *) override;
+    void updatePolish() override;
+    void hoverEnterEvent(QHoverEvent *event) override;
+    void hoverMoveEvent(QHoverEvent *event) override;
+    void hoverLeaveEvent(QHoverEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseReleaseEvent(QMouseEvent *event) override;
+    void mouseUngrabEvent() override;
+
+    Qt::Edges edgesAt(const QPointF &pos) const;
+    void setHoveredEdges(Qt::Edges edges);
+    void finishResize();
+
+protected:
+    QColor m_color = QColor(0xff, 0xff, 0xff, 0x50);
+    QColor m_borderColor = QColor(0x50, 0x70, 0xa0, 0x30);
+    QColor m_titlebarTopColor = QColor(0xff, 0xff, 0xff, 0x50);
+    QColor m_titlebarBottomColor = QColor(0xff, 0xff, 0xff, 0xe0);
+    QColor m_closeGlowColor = Qt::transparent;
+    QPointF m_closeGlowCenter;
+    qreal m_closeGlowRadius = 12;
+    qreal m_marginWidth = 6;
+    qreal m_titlebarHeight = 25;
+    qreal m_resizeAreaWidth = 12;
+    Qt::Edges m_hoveredEdges;
+    Qt::Edges m_resizeEdges;
+    QPointF m_pressScenePos;
+    QPointF m_resizeScenePos;
+    bool m_resizeUpdatePending = false;
+};
+
+#endif // WINDOWDECORATION_H
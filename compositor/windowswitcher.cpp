@@ -0,0 +1,162 @@
+#include "windowswitcher.h"
+#include "stackingmanager.h"
+#include "surfaceviewtracker.h"
+#include "workspacemanager.h"
+
+#include <QCoreApplication>
+#include <QKeyEvent>
+#include <QLoggingCategory>
+#include <QtWaylandCompositor/QWaylandCompositor>
+#include <QtWaylandCompositor/QWaylandSeat>
+#include <QtWaylandCompositor/QWaylandSurface>
+
+Q_LOGGING_CATEGORY(lcSwitcher, "grefsen.compositor.switcher")
+
+static QWaylandSurface *surfaceOf(QObject *shellSurface)
+{
+    return shellSurface ? shellSurface->property("surface").value<QWaylandSurface *>() : nullptr;
+}
+
+WindowSwitcher::WindowSwitcher(QObject *parent)
+    : QObject(parent)
+{
+    QCoreApplication::instance()->installEventFilter(this);
+}
+
+WindowSwitcher::~WindowSwitcher()
+{
+    if (QCoreApplication::instance())
+        QCoreApplication::instance()->removeEventFilter(this);
+}
+
+void WindowSwitcher::setCurrentIndex(int index)
+{
+    const int count = m_windows.count();
+    if (!count)
+        return;
+    index = (index % count + count) % count;
+    if (m_currentIndex == index)
+        return;
+    m_currentIndex = index;
+    emit currentIndexChanged();
+}
+
+void WindowSwitcher::next()
+{
+    if (m_open)
+        setCurrentIndex(m_currentIndex + 1);
+    else if (openSwitcher())
+        setCurrentIndex(1); // the one that had the focus before, usually
+}
+
+void WindowSwitcher::previous()
+{
+    if (m_open)
+        setCurrentIndex(m_currentIndex - 1);
+    else if (openSwitcher())
+        setCurrentIndex(-1);
+}
+
+bool WindowSwitcher::openSwitcher()
+{
+    StackingManager *stack = m_workspaceManager ? m_workspaceManager->currentStackingManager() : nullptr;
+    if (!stack)
+        return false;
+    const QList<QObject *> windows = stack->windows();
+    for (auto it = windows.crbegin(); it != windows.crend(); ++it) {
+        QObject *window = *it;
+        QWaylandSurface *surface = surfaceOf(window);
+        // dialogs are raised along with the windows that they belong to
+        if (!surface || !surface->hasContent() ||
+                SurfaceViewTracker::trackerFor(window->property("parentSurface").value<QObject *>()))
+            continue;
+        m_windows << window;
+        connect(window, &QObject::destroyed, this, &WindowSwitcher::windowDestroyed);
+    }
+    if (m_windows.isEmpty())
+        return false;
+    m_currentIndex = 0;
+    m_open = true;
+    qCDebug(lcSwitcher) << "opened with" << m_windows.count() << "windows";
+    emit windowsChanged();
+    emit currentIndexChanged();
+    emit openChanged();
+    return true;
+}
+
+void WindowSwitcher::commit()
+{
+    if (!m_open)
+        return;
+    QObject *window = m_windows.value(m_currentIndex);
+    close();
+    if (!window)
+        return;
+    qCDebug(lcSwitcher) << "switching to" << window;
+    if (m_workspaceManager)
+        m_workspaceManager->raise(window);
+    QWaylandSeat *seat = m_compositor ? m_compositor->defaultSeat() : nullptr;
+    if (seat)
+        seat->setKeyboardFocus(surfaceOf(window));
+}
+
+void WindowSwitcher::cancel()
+{
+    if (m_open)
+        close();
+}
+
+void WindowSwitcher::close()
+{
+    for (QObject *window : qAsConst(m_windows))
+        disconnect(window, nullptr, this, nullptr);
+    m_windows.clear();
+    m_open = false;
+    emit openChanged();
+    emit windowsChanged();
+}
+
+void WindowSwitcher::windowDestroyed(QObject *window)
+{
+    const int index = m_windows.indexOf(window);
+    if (index < 0)
+        return;
+    m_windows.removeAt(index);
+    if (m_windows.isEmpty()) {
+        close();
+        return;
+    }
+    if (index < m_currentIndex || m_currentIndex == m_windows.count())
+        --m_currentIndex;
+    emit windowsChanged();
+    emit currentIndexChanged();
+}
+
+bool WindowSwitcher::eventFilter(QObject *watched, QEvent *event)
+{
+    // each key event is also delivered to items; look at it only once
+    if (!watched->isWindowType() || (event->type() != QEvent::KeyPress && event->type() != QEvent::KeyRelease))
+        return false;
+    QKeyEvent *ke = static_cast<QKeyEvent *>(event);
+    const bool tab = ke->key() == Qt::Key_Tab || ke->key() == Qt::Key_Backtab;
+    if (tab && (ke->modifiers() & Qt::AltModifier)) {
+        if (event->type() == QEvent::KeyPress) {
+            if (ke->key() == Qt::Key_Backtab || (ke->modifiers() & Qt::ShiftModifier))
+                previous();
+            else
+                next();
+        }
+        return true;
+    }
+    if (!m_open)
+        return false;
+    if (ke->key() == Qt::Key_Escape) {
+        if (event->type() == QEvent::KeyPress)
+            cancel();
+        return true;
+    }
+    // the client sees Alt being released as usual
+    if (ke->key() == Qt::Key_Alt && event->type() == QEvent::KeyRelease)
+        commit();
+    return false;
+}
@@ -0,0 +1,67 @@
+#ifndef WINDOWSWITCHER_H
+#define WINDOWSWITCHER_H
+
+#include <QObject>
+#include <QPointer>
+
+class QWaylandCompositor;
+class WorkspaceManager;
+
+/*!
+    Alt-tab: Alt+Tab opens the switcher with the windows on the current
+    workspace, from the top of the stack down, and selects the next one;
+    Alt+Shift+Tab selects the previous one. Releasing Alt raises the
+    selected window and gives it the keyboard focus; Escape closes the
+    switcher without changing anything.
+
+    The keys are taken from the application's event filter, so that the
+    client with the keyboard focus doesn't see them. The windows are
+    shown (see WindowSwitcherPanel.qml) with pictures from the
+    ThumbnailCache.
+*/
+class WindowSwitcher : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(QWaylandCompositor *compositor MEMBER m_compositor NOTIFY compositorChanged)
+    Q_PROPERTY(WorkspaceManager *workspaceManager MEMBER m_workspaceManager NOTIFY workspaceManagerChanged)
+    Q_PROPERTY(bool open READ isOpen NOTIFY openChanged)
+    Q_PROPERTY(QList<QObject *> windows READ windows NOTIFY windowsChanged)
+    Q_PROPERTY(int currentIndex READ currentIndex WRITE setCurrentIndex NOTIFY currentIndexChanged)
+
+public:
+    explicit WindowSwitcher(QObject *parent = nullptr);
+    ~WindowSwitcher() override;
+
+    bool isOpen() const { return m_open; }
+    QList<QObject *> windows() const { return m_windows; }
+    int currentIndex() const { return m_currentIndex; }
+    void setCurrentIndex(int index);
+
+signals:
+    void compositorChanged();
+    void workspaceManagerChanged();
+    void openChanged();
+    void windowsChanged();
+    void currentIndexChanged();
+
+public slots:
+    void next();
+    void previous();
+    void commit();
+    void cancel();
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+    bool openSwitcher();
+    void close();
+    void windowDestroyed(QObject *window);
+
+protected:
+    QPointer<QWaylandCompositor> m_compositor;
+    QPointer<WorkspaceManager> m_workspaceManager;
+    QList<QObject *> m_windows; // from the top down
+    int m_currentIndex = 0;
+    bool m_open = false;
+};
+
+#endif // WINDOWSWITCHER_H
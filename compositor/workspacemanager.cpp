@@ -0,0 +1,256 @@
+#include "workspacemanager.h"
+#include "framepacer.h"
+#include "stackingmanager.h"
+#include "surfaceviewtracker.h"
+
+#include <QLoggingCategory>
+#include <QSettings>
+#include <QtWaylandCompositor/QWaylandCompositor>
+#include <QtWaylandCompositor/QWaylandSeat>
+#include <QtWaylandCompositor/QWaylandSurface>
+
+Q_LOGGING_CATEGORY(lcWorkspaces, "grefsen.compositor.workspaces")
+
+static const char *WorkspaceAreaProperty = "workspaceArea";
+
+static QWaylandSurface *surfaceOf(QObject *shellSurface)
+{
+    return shellSurface ? shellSurface->property("surface").value<QWaylandSurface *>() : nullptr;
+}
+
+static SurfaceViewTracker *trackerOf(QObject *shellSurface)
+{
+    return SurfaceViewTracker::trackerFor(surfaceOf(shellSurface));
+}
+
+// the window that a transient window belongs to, if any
+static QObject *parentWindow(QObject *shellSurface)
+{
+    SurfaceViewTracker *parentTracker = SurfaceViewTracker::trackerFor(shellSurface->property("parentSurface").value<QObject *>());
+    return parentTracker ? parentTracker->shellSurface() : nullptr;
+}
+
+WorkspaceManager::WorkspaceManager(QObject *parent)
+    : QObject(parent)
+{
+    QSettings settings;
+    const int count = qMax(1, settings.value(QStringLiteral("workspaces/count"), 4).toInt());
+    for (int i = 0; i < count; ++i)
+        m_stacks << new StackingManager(this);
+}
+
+void WorkspaceManager::setOutputs(const QList<QObject *> &outputs)
+{
+    if (m_outputs == outputs)
+        return;
+    for (QObject *output : outputs)
+        if (!m_areas.contains(output))
+            addOutput(output);
+    for (QObject *output : qAsConst(m_outputs))
+        if (!outputs.contains(output))
+            m_areas.remove(output);
+    m_outputs = outputs;
+    emit outputsChanged();
+}
+
+void WorkspaceManager::addOutput(QObject *output)
+{
+    QQuickItem *surfaceArea = output->property("surfaceArea").value<QQuickItem *>();
+    if (!surfaceArea)
+        return;
+    QVector<QPointer<QQuickItem>> areas;
+    for (int i = 0; i < count(); ++i) {
+        QQuickItem *area = new QQuickItem(surfaceArea);
+        area->setObjectName(QStringLiteral("workspace %1").arg(i + 1));
+        area->setSize(surfaceArea->size());
+        area->setVisible(i == m_current);
+        areas << area;
+    }
+    auto resize = [surfaceArea, areas]() {
+        for (const QPointer<QQuickItem> &area : areas)
+            if (area)
+                area->setSize(surfaceArea->size());
+    };
+    connect(surfaceArea, &QQuickItem::widthChanged, this, resize);
+    connect(surfaceArea, &QQuickItem::heightChanged, this, resize);
+    connect(output, &QObject::destroyed, this, [this, output]() {
+        m_areas.remove(output);
+        m_outputs.removeAll(output);
+    });
+    m_areas.insert(output, areas);
+    output->setProperty(WorkspaceAreaProperty, QVariant::fromValue(areas.at(m_current).data()));
+
+    // windows that already have views on this output
+    for (auto it = m_windows.constBegin(); it != m_windows.constEnd(); ++it)
+        if (SurfaceViewTracker *tracker = trackerOf(it.key()))
+            if (QQuickItem *view = tracker->viewOn(output))
+                adoptView(it.key(), view, output);
+}
+
+void WorkspaceManager::setCurrent(int current)
+{
+    if (current < 0 || current >= count() || current == m_current)
+        return;
+    const int previous = m_current;
+    m_current = current;
+    // two items per output, no matter how many windows
+    for (auto it = m_areas.constBegin(); it != m_areas.constEnd(); ++it) {
+        const QVector<QPointer<QQuickItem>> &areas = it.value();
+        if (areas.at(previous))
+            areas.at(previous)->setVisible(false);
+        if (areas.at(current)) {
+            areas.at(current)->setVisible(true);
+            it.key()->setProperty(WorkspaceAreaProperty, QVariant::fromValue(areas.at(current).data()));
+        }
+    }
+    if (m_framePacer) {
+        m_framePacer->setSuspended(surfacesOn(previous), true);
+        m_framePacer->setSuspended(surfacesOn(current), false);
+    }
+    updateFocus();
+    qCDebug(lcWorkspaces) << "switched from workspace" << previous + 1 << "to" << current + 1;
+    emit currentChanged();
+}
+
+void WorkspaceManager::track(QObject *shellSurface)
+{
+    if (!shellSurface || m_windows.contains(shellSurface))
+        return;
+    QObject *parent = parentWindow(shellSurface);
+    const int workspace = m_windows.value(parent, m_current);
+    m_windows.insert(shellSurface, workspace);
+    m_stacks.at(workspace)->track(shellSurface);
+    if (SurfaceViewTracker *tracker = trackerOf(shellSurface)) {
+        reparentViews(shellSurface);
+        connect(tracker, &SurfaceViewTracker::viewCreated, this, [this, shellSurface](QQuickItem *view, QObject *output) {
+            adoptView(shellSurface, view, output);
+        });
+    }
+    connect(shellSurface, &QObject::destroyed, this, [this, shellSurface]() { untrack(shellSurface); });
+    if (workspace != m_current && m_framePacer)
+        m_framePacer->setSuspended(QList<QWaylandSurface *>() << surfaceOf(shellSurface), true);
+}
+
+void WorkspaceManager::untrack(QObject *shellSurface)
+{
+    // its StackingManager forgets it by itself
+    m_windows.remove(shellSurface);
+}
+
+int WorkspaceManager::stackIndex(QObject *shellSurface) const
+{
+    StackingManager *stack = m_stacks.value(workspaceOf(shellSurface));
+    return stack ? stack->stackIndex(shellSurface) : -1;
+}
+
+void WorkspaceManager::raise(QObject *shellSurface)
+{
+    if (StackingManager *stack = m_stacks.value(workspaceOf(shellSurface)))
+        stack->raise(shellSurface);
+}
+
+void WorkspaceManager::lower(QObject *shellSurface)
+{
+    if (StackingManager *stack = m_stacks.value(workspaceOf(shellSurface)))
+        stack->lower(shellSurface);
+}
+
+// top-level views go into the window's workspace's item on each output;
+// transient windows' views are children of their parents' views, and go along with them
+void WorkspaceManager::adoptView(QObject *shellSurface, QQuickItem *view, QObject *output)
+{
+    const int workspace = workspaceOf(shellSurface);
+    const QVector<QPointer<QQuickItem>> areas = m_areas.value(output);
+    if (workspace < 0 || workspace >= areas.count() || !areas.at(workspace))
+        return;
+    QQuickItem *parent = view->parentItem();
+    bool topLevel = parent == output->property("surfaceArea").value<QQuickItem *>();
+    for (int i = 0; i < areas.count() && !topLevel; ++i)
+        topLevel = parent && areas.at(i) == parent;
+    if (topLevel && parent != areas.at(workspace))
+        view->setParentItem(areas.at(workspace));
+}
+
+void WorkspaceManager::reparentViews(QObject *shellSurface)
+{
+    SurfaceViewTracker *tracker = trackerOf(shellSurface);
+    if (!tracker)
+        return;
+    for (auto it = m_areas.constBegin(); it != m_areas.constEnd(); ++it)
+        if (QQuickItem *view = tracker->viewOn(it.key()))
+            adoptView(shellSurface, view, it.key());
+}
+
+void WorkspaceManager::moveToWorkspace(QObject *shellSurface, int workspace)
+{
+    move(shellSurface, workspace);
+    updateFocus();
+}
+
+void WorkspaceManager::move(QObject *shellSurface, int workspace)
+{
+    auto it = m_windows.find(shellSurface);
+    if (it == m_windows.end() || workspace < 0 || workspace >= count() || *it == workspace)
+        return;
+    const int from = *it;
+    *it = workspace;
+    m_stacks.at(from)->untrack(shellSurface);
+    m_stacks.at(workspace)->track(shellSurface);
+    reparentViews(shellSurface);
+    if (m_framePacer)
+        m_framePacer->setSuspended(QList<QWaylandSurface *>() << surfaceOf(shellSurface), workspace != m_current);
+    qCDebug(lcWorkspaces) << "moved" << shellSurface << "from workspace" << from + 1 << "to" << workspace + 1;
+    emit windowMoved(shellSurface, workspace);
+
+    // its dialogs go along
+    const QList<QObject *> windows = m_windows.keys();
+    for (QObject *window : windows)
+        if (parentWindow(window) == shellSurface)
+            move(window, workspace);
+}
+
+void WorkspaceManager::switchBy(int delta, bool takeFocusedWindow)
+{
+    const int target = ((m_current + delta) % count() + count()) % count();
+    if (target == m_current)
+        return;
+    if (takeFocusedWindow) {
+        if (QObject *focused = focusedWindow())
+            move(focused, target);
+    }
+    setCurrent(target);
+}
+
+QList<QWaylandSurface *> WorkspaceManager::surfacesOn(int workspace) const
+{
+    QList<QWaylandSurface *> ret;
+    const QList<QObject *> windows = m_stacks.at(workspace)->windows();
+    for (QObject *window : windows)
+        if (QWaylandSurface *surface = surfaceOf(window))
+            ret << surface;
+    return ret;
+}
+
+QObject *WorkspaceManager::focusedWindow() const
+{
+    QWaylandSeat *seat = m_compositor ? m_compositor->defaultSeat() : nullptr;
+    QWaylandSurface *focus = seat ? seat->keyboardFocus() : nullptr;
+    if (!focus)
+        return nullptr;
+    for (auto it = m_windows.constBegin(); it != m_windows.constEnd(); ++it)
+        if (surfaceOf(it.key()) == focus)
+            return it.key();
+    return nullptr;
+}
+
+// a window on a workspace that isn't shown can't keep the keyboard focus
+void WorkspaceManager::updateFocus()
+{
+    QWaylandSeat *seat = m_compositor ? m_compositor->defaultSeat() : nullptr;
+    if (!seat)
+        return;
+    QObject *focused = focusedWindow();
+    if (seat->keyboardFocus() && (!focused || workspaceOf(focused) == m_current))
+        return;
+    seat->setKeyboardFocus(surfaceOf(currentStackingManager()->topWindow()));
+}
@@ -0,0 +1,96 @@
+#ifndef WORKSPACEMANAGER_H
+#define WORKSPACEMANAGER_H
+
+#include <QHash>
+#include <QObject>
+#include <QPointer>
+#include <QQuickItem>
+#include <QVector>
+
+class FramePacer;
+class QWaylandCompositor;
+class QWaylandSurface;
+class StackingManager;
+
+/*!
+    Virtual desktops. Each workspace has its own StackingManager, and on
+    each output, an item in the output's \c surfaceArea that the views of
+    its windows are parented to; only the current workspace's items are
+    visible, so switching is a matter of hiding one item and showing
+    another on each output, however many windows there are. The output's
+    \c workspaceArea property is set to the current one, for the
+    OcclusionCuller and FullscreenBypass.
+
+    The windows on the other workspaces are not rendered, and the
+    FramePacer suspends their frame callbacks until their workspace is
+    shown again. If the window with keyboard focus goes away with its
+    workspace, the focus goes to the top window of the one that's shown,
+    so the client sees that it's no longer activated.
+
+    \code
+    [workspaces]
+    count=4
+    \endcode
+*/
+class WorkspaceManager : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(QWaylandCompositor *compositor MEMBER m_compositor NOTIFY compositorChanged)
+    Q_PROPERTY(FramePacer *framePacer MEMBER m_framePacer NOTIFY framePacerChanged)
+    Q_PROPERTY(QList<QObject *> outputs READ outputs WRITE setOutputs NOTIFY outputsChanged)
+    Q_PROPERTY(int count READ count CONSTANT)
+    Q_PROPERTY(int current READ current WRITE setCurrent NOTIFY currentChanged)
+    Q_PROPERTY(StackingManager *currentStackingManager READ currentStackingManager NOTIFY currentChanged)
+
+public:
+    explicit WorkspaceManager(QObject *parent = nullptr);
+
+    QList<QObject *> outputs() const { return m_outputs; }
+    void setOutputs(const QList<QObject *> &outputs);
+    int count() const { return m_stacks.count(); }
+    int current() const { return m_current; }
+    void setCurrent(int current);
+    StackingManager *currentStackingManager() const { return m_stacks.at(m_current); }
+
+    // a new window goes on the current workspace, or on its parent's
+    Q_INVOKABLE void track(QObject *shellSurface);
+    Q_INVOKABLE int workspaceOf(QObject *shellSurface) const { return m_windows.value(shellSurface, -1); }
+    Q_INVOKABLE StackingManager *stackingManager(int workspace) const { return m_stacks.value(workspace); }
+    Q_INVOKABLE int stackIndex(QObject *shellSurface) const;
+    Q_INVOKABLE void moveToWorkspace(QObject *shellSurface, int workspace);
+    // to the next (or previous) workspace, maybe taking the window with keyboard focus along
+    Q_INVOKABLE void switchBy(int delta, bool takeFocusedWindow = false);
+
+public slots:
+    void raise(QObject *shellSurface);
+    void lower(QObject *shellSurface);
+
+signals:
+    void compositorChanged();
+    void framePacerChanged();
+    void outputsChanged();
+    void currentChanged();
+    void windowMoved(QObject *shellSurface, int workspace);
+
+protected:
+    void addOutput(QObject *output);
+    void adoptView(QObject *shellSurface, QQuickItem *view, QObject *output);
+    void reparentViews(QObject *shellSurface);
+    void move(QObject *shellSurface, int workspace);
+    void untrack(QObject *shellSurface);
+    QList<QWaylandSurface *> surfacesOn(int workspace) const;
+    QObject *focusedWindow() const;
+    void updateFocus();
+
+protected:
+    QPointer<QWaylandCompositor> m_compositor;
+    QPointer<FramePacer> m_framePacer;
+    QList<QObject *> m_outputs;
+    // for each output, an item per workspace
+    QHash<QObject *, QVector<QPointer<QQuickItem>>> m_areas;
+    QVector<StackingManager *> m_stacks;
+    QHash<QObject *, int> m_windows;
+    int m_current = 0;
+};
+
+#endif // WORKSPACEMANAGER_H
@@ -2,9 +2,12 @@ import QtQuick 2.6
 import Grefsen 1.0
 
 Image {
+    asynchronous: true
     fillMode: Image.PreserveAspectCrop
+    // decoded once for all outputs, and cached in ~/.cache/grefsen/wallpapers at the size of each
+    sourceSize: Qt.size(width, height)
     // download from https://commons.wikimedia.org/wiki/File:Oslo_mot_Grefsentoppen_fra_Ekeberg.jpg
-    source: Env.grefsenconfig + "Oslo_mot_Grefsentoppen_fra_Ekeberg.jpg"
+    source: width > 0 && height > 0 ? "image://wallpaper/" + Env.grefsenconfig + "Oslo_mot_Grefsentoppen_fra_Ekeberg.jpg" : ""
 
     // TODO set the icon theme
 
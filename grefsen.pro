@@ -1,3 +1,6 @@
 TEMPLATE = subdirs
 
 SUBDIRS += compositor imports example-config thirdparty
+
+# the benchmark's synthetic clients use libwayland-client and generate the xdg-shell code
+packagesExist(wayland-client wayland-protocols wayland-scanner): SUBDIRS += benchmark
@@ -2,17 +2,30 @@ TEMPLATE = lib
 TARGET  = grefsenplugin
 TARGETPATH = Grefsen
 QT += qml quick xml
-CONFIG += link_pkgconfig
+CONFIG += link_pkgconfig qtquickcompiler
 QMAKE_CXXFLAGS += -std=c++17
 PKGCONFIG += glib-2.0 Qt6Xdg
 
 SOURCES += \
     plugin.cpp \
+    iconindex.cpp \
     iconprovider.cpp \
-    launchermodel.cpp
+    launchermodel.cpp \
+    launchersearch.cpp \
+    launchertree.cpp \
+    menucache.cpp \
+    wallpaperprovider.cpp
 
 HEADERS += \
+    iconindex.h \
     iconprovider.h \
-    launchermodel.h
+    launchermodel.h \
+    launchersearch.h \
+    launchertree.h \
+    menucache.h \
+    wallpaperprovider.h
 
 OTHER_FILES += *.qml
+
+# compiled ahead of time; qmldir prefers these to the .qml files next to it
+RESOURCES += Grefsen.qrc
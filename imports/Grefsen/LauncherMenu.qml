@@ -53,11 +53,11 @@ Item {
         anchors.bottomMargin: 0
         anchors.margins: 6
         clip: true
-        model: LauncherModel.applicationMenu
+        model: LauncherModel
         delegate: MouseArea {
             width: parent.width
             height: 32
-            onClicked: LauncherModel.select(modelData)
+            onClicked: LauncherModel.select(index)
 
             Rectangle {
                 radius: 2
@@ -66,7 +66,7 @@ Item {
                 opacity: 0.35
             }
             Image {
-                source: "image://icon/" + modelData.icon
+                source: "image://icon/" + model.icon
                 sourceSize.width: 22
                 sourceSize.height: 22
                 anchors.verticalCenter: parent.verticalCenter
@@ -76,10 +76,13 @@ Item {
                 anchors.verticalCenter: parent.verticalCenter
                 x: 30
                 elide: Text.ElideRight
-                text: modelData.title
-//                Component.onCompleted: console.log(" "+ JSON.stringify(modelData))
+                text: model.title
                 width: parent.width - x - 4
             }
         }
     }
+    BusyIndicator {
+        anchors.centerIn: list
+        running: LauncherModel.loading
+    }
 }
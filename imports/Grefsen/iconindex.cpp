@@ -0,0 +1,338 @@
+#include "iconindex.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QIcon>
+#include <QLoggingCategory>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+#include <QTextStream>
+#include <QThread>
+#include <climits>
+#include <functional>
+
+Q_LOGGING_CATEGORY(lcIconIndex, "grefsen.iconindex")
+
+static const quint32 CacheMagic = 0x47524949; // "GRII"
+static const quint32 CacheVersion = 1;
+static const QString UsrSharePixmaps = QStringLiteral("/usr/share/pixmaps");
+static const QStringList IconNameFilters = { QStringLiteral("*.png"), QStringLiteral("*.svg"),
+                                             QStringLiteral("*.svgz"), QStringLiteral("*.xpm") };
+
+typedef QList<QPair<QString, qint64> > Stamps;
+
+struct ThemeDirectory
+{
+    QString name;
+    int size = 0;
+    int minSize = 0;
+    int maxSize = 0;
+};
+
+struct ThemeInfo
+{
+    QStringList inherits;
+    QVector<ThemeDirectory> directories;
+};
+
+QDataStream &operator<<(QDataStream &out, const IconIndex::Entry &e)
+{
+    return out << e.path << e.size << e.minSize << e.maxSize;
+}
+
+QDataStream &operator>>(QDataStream &in, IconIndex::Entry &e)
+{
+    return in >> e.path >> e.size >> e.minSize >> e.maxSize;
+}
+
+static qint64 mtime(const QString &path)
+{
+    QFileInfo fi(path);
+    return fi.exists() ? fi.lastModified().toMSecsSinceEpoch() : -1;
+}
+
+// index.theme is an ini file, but directory names contain slashes, which QSettings treats specially
+static ThemeInfo parseIndexTheme(const QString &path)
+{
+    ThemeInfo ret;
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly | QIODevice::Text))
+        return ret;
+    QHash<QString, QHash<QString, QString> > sections;
+    QString section;
+    QTextStream in(&f);
+    while (!in.atEnd()) {
+        QString line = in.readLine().trimmed();
+        if (line.isEmpty() || line.startsWith('#'))
+            continue;
+        if (line.startsWith('[') && line.endsWith(']')) {
+            section = line.mid(1, line.length() - 2);
+            continue;
+        }
+        int eq = line.indexOf('=');
+        if (eq > 0)
+            sections[section].insert(line.left(eq).trimmed(), line.mid(eq + 1).trimmed());
+    }
+    const QHash<QString, QString> &theme = sections[QStringLiteral("Icon Theme")];
+    ret.inherits = theme.value(QStringLiteral("Inherits")).split(',', Qt::SkipEmptyParts);
+    QStringList dirs = theme.value(QStringLiteral("Directories")).split(',', Qt::SkipEmptyParts);
+    dirs += theme.value(QStringLiteral("ScaledDirectories")).split(',', Qt::SkipEmptyParts);
+    for (const QString &name : qAsConst(dirs)) {
+        const QHash<QString, QString> &props = sections[name.trimmed()];
+        ThemeDirectory dir;
+        dir.name = name.trimmed();
+        dir.size = props.value(QStringLiteral("Size")).toInt();
+        if (props.value(QStringLiteral("Scale"), QStringLiteral("1")).toInt() != 1)
+            continue; // @2x directories; the requested size is already in pixels
+        QString type = props.value(QStringLiteral("Type"), QStringLiteral("Threshold"));
+        if (type == QLatin1String("Fixed")) {
+            dir.minSize = dir.maxSize = dir.size;
+        } else if (type == QLatin1String("Scalable")) {
+            dir.minSize = props.value(QStringLiteral("MinSize"), QString::number(dir.size)).toInt();
+            dir.maxSize = props.value(QStringLiteral("MaxSize"), QString::number(dir.size)).toInt();
+        } else {
+            int threshold = props.value(QStringLiteral("Threshold"), QStringLiteral("2")).toInt();
+            dir.minSize = dir.size - threshold;
+            dir.maxSize = dir.size + threshold;
+        }
+        ret.directories.append(dir);
+    }
+    return ret;
+}
+
+static void addFiles(IconIndex::Index &index, const QString &dirPath, const IconIndex::Entry &proto)
+{
+    const QFileInfoList files = QDir(dirPath).entryInfoList(IconNameFilters, QDir::Files);
+    for (const QFileInfo &fi : files) {
+        IconIndex::Entry e = proto;
+        e.path = fi.filePath();
+        index[fi.completeBaseName()].append(e);
+    }
+}
+
+static IconIndex::Index buildIndex(const QString &themeName, const QStringList &searchPaths, Stamps &stamps)
+{
+    // themes in lookup order: the theme, then what it inherits, depth first; hicolor last
+    QStringList themes;
+    QHash<QString, ThemeInfo> infos;
+    std::function<void(const QString &)> visit = [&](const QString &theme) {
+        if (themes.contains(theme))
+            return;
+        themes << theme;
+        ThemeInfo &info = infos[theme];
+        for (const QString &base : searchPaths) {
+            QString indexFile = base + '/' + theme + QLatin1String("/index.theme");
+            if (!QFileInfo::exists(indexFile))
+                continue;
+            ThemeInfo parsed = parseIndexTheme(indexFile);
+            stamps.append(qMakePair(indexFile, mtime(indexFile)));
+            info.directories += parsed.directories;
+            if (info.inherits.isEmpty())
+                info.inherits = parsed.inherits;
+        }
+        for (const QString &parent : qAsConst(info.inherits))
+            if (parent.trimmed() != QLatin1String("hicolor"))
+                visit(parent.trimmed());
+    };
+    visit(themeName);
+    visit(QStringLiteral("hicolor"));
+
+    for (const QString &base : searchPaths)
+        stamps.append(qMakePair(base, mtime(base)));
+
+    IconIndex::Index ret;
+    for (const QString &theme : qAsConst(themes)) {
+        IconIndex::Index themeIndex;
+        for (const QString &base : searchPaths) {
+            for (const ThemeDirectory &dir : qAsConst(infos[theme].directories)) {
+                QString dirPath = base + '/' + theme + '/' + dir.name;
+                qint64 t = mtime(dirPath);
+                if (t < 0)
+                    continue;
+                stamps.append(qMakePair(dirPath, t));
+                IconIndex::Entry proto;
+                proto.size = dir.size;
+                proto.minSize = dir.minSize;
+                proto.maxSize = dir.maxSize;
+                addFiles(themeIndex, dirPath, proto);
+            }
+        }
+        // a name found in an earlier theme hides the same name in the themes it inherits
+        for (auto it = themeIndex.constBegin(); it != themeIndex.constEnd(); ++it)
+            if (!ret.contains(it.key()))
+                ret.insert(it.key(), it.value());
+    }
+
+    IconIndex::Index pixmaps;
+    addFiles(pixmaps, UsrSharePixmaps, IconIndex::Entry());
+    stamps.append(qMakePair(UsrSharePixmaps, mtime(UsrSharePixmaps)));
+    for (auto it = pixmaps.constBegin(); it != pixmaps.constEnd(); ++it)
+        if (!ret.contains(it.key()))
+            ret.insert(it.key(), it.value());
+    return ret;
+}
+
+static bool loadCache(const QString &path, IconIndex::Index &index, Stamps &stamps)
+{
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly))
+        return false;
+    QDataStream in(&f);
+    quint32 magic = 0, version = 0;
+    in >> magic >> version;
+    if (magic != CacheMagic || version != CacheVersion)
+        return false;
+    in.setVersion(QDataStream::Qt_6_0);
+    in >> stamps;
+    for (const auto &stamp : qAsConst(stamps)) {
+        if (mtime(stamp.first) != stamp.second) {
+            qCDebug(lcIconIndex) << "stale because of" << stamp.first;
+            return false;
+        }
+    }
+    in >> index;
+    return in.status() == QDataStream::Ok;
+}
+
+static void saveCache(const QString &path, const IconIndex::Index &index, const Stamps &stamps)
+{
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile f(path);
+    if (!f.open(QIODevice::WriteOnly))
+        return;
+    QDataStream out(&f);
+    out << CacheMagic << CacheVersion;
+    out.setVersion(QDataStream::Qt_6_0);
+    out << stamps << index;
+    if (!f.commit())
+        qWarning() << "failed to write icon index" << path;
+}
+
+IconIndex::IconIndex(const QString &themeName, QObject *parent)
+  : QObject(parent)
+  , m_themeName(themeName)
+  , m_cachePath(QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) +
+                QLatin1String("/grefsen/iconindex-") + themeName + QLatin1String(".cache"))
+{
+    m_rebuildTimer.setSingleShot(true);
+    m_rebuildTimer.setInterval(2000); // package installs touch many directories
+    connect(&m_rebuildTimer, &QTimer::timeout, this, &IconIndex::rebuild);
+    connect(&m_watcher, &QFileSystemWatcher::directoryChanged, &m_rebuildTimer, qOverload<>(&QTimer::start));
+    rebuild();
+}
+
+IconIndex::~IconIndex()
+{
+    if (m_builder)
+        m_builder->wait();
+}
+
+bool IconIndex::isReady() const
+{
+    QReadLocker lock(&m_lock);
+    return m_ready;
+}
+
+// Icon=foo.png is common in third-party .desktop files, although the spec wants just the name
+static QString withoutImageSuffix(const QString &name)
+{
+    for (const QString &filter : IconNameFilters) {
+        const QStringView suffix = QStringView(filter).mid(1); // without the *
+        if (name.endsWith(suffix) && name.length() > suffix.length())
+            return name.left(name.length() - suffix.length());
+    }
+    return QString();
+}
+
+QString IconIndex::lookup(const QString &name, int size) const
+{
+    QReadLocker lock(&m_lock);
+    auto found = m_index.constFind(name);
+    if (found == m_index.constEnd()) {
+        const QString baseName = withoutImageSuffix(name);
+        if (!baseName.isEmpty())
+            found = m_index.constFind(baseName);
+    }
+    if (found == m_index.constEnd())
+        return QString();
+    // as in the icon theme spec: an exact match if possible, otherwise the closest size
+    QString ret;
+    int bestDistance = INT_MAX;
+    for (const Entry &e : *found) {
+        if (e.size == 0) { // /usr/share/pixmaps
+            if (ret.isEmpty())
+                ret = e.path;
+            continue;
+        }
+        if (size >= e.minSize && size <= e.maxSize)
+            return e.path;
+        int distance = size < e.minSize ? e.minSize - size : size - e.maxSize;
+        if (distance < bestDistance) {
+            bestDistance = distance;
+            ret = e.path;
+        }
+    }
+    return ret;
+}
+
+void IconIndex::rebuild()
+{
+    if (m_builder) {
+        m_rebuildPending = true;
+        return;
+    }
+    const QString themeName = m_themeName;
+    const QString cachePath = m_cachePath;
+    const QStringList searchPaths = QIcon::themeSearchPaths();
+    // the first time, a valid cache is good enough; after a change notification, always rebuild
+    const bool useCache = !isReady();
+    m_builder = QThread::create([=]() {
+        QElapsedTimer timer;
+        timer.start();
+        Index index;
+        Stamps stamps;
+        if (!useCache || !loadCache(cachePath, index, stamps)) {
+            index.clear();
+            stamps.clear();
+            index = buildIndex(themeName, searchPaths, stamps);
+            saveCache(cachePath, index, stamps);
+            qCDebug(lcIconIndex) << "built index of" << index.count() << "icons for" << themeName << "in" << timer.elapsed() << "ms";
+        } else {
+            qCDebug(lcIconIndex) << "loaded index of" << index.count() << "icons for" << themeName << "in" << timer.elapsed() << "ms";
+        }
+        QStringList directories;
+        for (const auto &stamp : qAsConst(stamps))
+            if (QFileInfo(stamp.first).isDir())
+                directories << stamp.first;
+        QMetaObject::invokeMethod(this, [this, index, directories]() { setIndex(index, directories); }, Qt::QueuedConnection);
+    });
+    connect(m_builder, &QThread::finished, this, [this]() {
+        m_builder->deleteLater();
+        m_builder = nullptr;
+        if (m_rebuildPending) {
+            m_rebuildPending = false;
+            rebuild();
+        }
+    });
+    m_builder->start(QThread::LowPriority);
+}
+
+void IconIndex::setIndex(const Index &index, const QStringList &directories)
+{
+    {
+        QWriteLocker lock(&m_lock);
+        m_index = index;
+        m_ready = true;
+    }
+    if (!m_watcher.directories().isEmpty())
+        m_watcher.removePaths(m_watcher.directories());
+    if (!directories.isEmpty())
+        m_watcher.addPaths(directories);
+    emit ready();
+}
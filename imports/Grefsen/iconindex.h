@@ -0,0 +1,65 @@
+#ifndef ICONINDEX_H
+#define ICONINDEX_H
+
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QObject>
+#include <QReadWriteLock>
+#include <QTimer>
+#include <QVector>
+
+class QThread;
+
+/*!
+    Maps icon names to files in an icon theme, the themes it inherits,
+    hicolor and /usr/share/pixmaps, so that finding an icon is a hash lookup
+    rather than a walk through the theme directories.
+
+    The index is loaded from ~/.cache/grefsen (or built, if any of the
+    directories it was built from has changed since) on a worker thread.
+    Until it's ready, lookup() returns nothing and callers must fall back to
+    QIcon::fromTheme(). A name with an image suffix (foo.png) is looked up
+    without it. QFileSystemWatcher triggers a rebuild when an icon
+    directory changes. lookup() may be called from any thread.
+*/
+class IconIndex : public QObject
+{
+    Q_OBJECT
+public:
+    explicit IconIndex(const QString &themeName, QObject *parent = 0);
+    ~IconIndex();
+
+    QString themeName() const { return m_themeName; }
+    bool isReady() const;
+    QString lookup(const QString &name, int size) const;
+
+    struct Entry {
+        QString path;
+        qint16 size = 0;     // 0 for /usr/share/pixmaps: size unknown
+        qint16 minSize = 0;
+        qint16 maxSize = 0;
+    };
+    typedef QHash<QString, QVector<Entry> > Index;
+
+signals:
+    void ready();
+
+public slots:
+    void rebuild();
+
+protected:
+    void setIndex(const Index &index, const QStringList &directories);
+
+protected:
+    QString m_themeName;
+    QString m_cachePath;
+    mutable QReadWriteLock m_lock;
+    Index m_index;
+    bool m_ready = false;
+    QThread *m_builder = nullptr;
+    bool m_rebuildPending = false;
+    QFileSystemWatcher m_watcher;
+    QTimer m_rebuildTimer;
+};
+
+#endif // ICONINDEX_H
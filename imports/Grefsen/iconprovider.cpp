@@ -1,54 +1,237 @@
 #include "iconprovider.h"
+#include "iconindex.h"
 #include <qt5xdg/XdgIcon>
 
+#include <QCryptographicHash>
+#include <QDateTime>
 #include <QDebug>
 #include <QDir>
 #include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QIcon>
+#include <QImageReader>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QSettings>
+#include <QStandardPaths>
 
 static QDir UsrSharePixmaps("/usr/share/pixmaps");
+static const int MemoryCacheBytes = 16 * 1024 * 1024;
+static const QSize DefaultIconSize(64, 64);
+static const int DiskCacheMaxAgeDays = 60; // unused for this long: an uninstalled app, an old theme, a size no longer shown
+
+// QIcon::fromTheme() and the icon engines are not thread-safe;
+// only one loader thread at a time may use them
+static QMutex themeMutex;
+
+class IconLoader : public QObject, public QRunnable
+{
+    Q_OBJECT
+public:
+    IconLoader(IconProvider *provider, const QString &id, const QSize &requestedSize)
+      : m_provider(provider), m_id(id), m_requestedSize(requestedSize) { }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        emit done(m_provider->image(m_id, m_requestedSize));
+    }
+
+signals:
+    void done(QImage image);
+
+private:
+    IconProvider *m_provider;
+    QString m_id;
+    QSize m_requestedSize;
+};
+
+class IconResponse : public QQuickImageResponse
+{
+public:
+    IconResponse(IconProvider *provider, QThreadPool *pool, const QString &id, const QSize &requestedSize)
+    {
+        IconLoader *loader = new IconLoader(provider, id, requestedSize);
+        connect(loader, &IconLoader::done, this, &IconResponse::handleDone);
+        pool->start(loader);
+    }
+
+    // the default factory uploads with TextureCanUseAtlas, so icons already share the scene graph's
+    // atlas and are drawn in common batches; only images over QSG_ATLAS_SIZE_LIMIT get their own texture
+    QQuickTextureFactory *textureFactory() const Q_DECL_OVERRIDE
+    {
+        return QQuickTextureFactory::textureFactoryForImage(m_image);
+    }
+
+    void handleDone(QImage image)
+    {
+        m_image = image;
+        emit finished();
+    }
+
+private:
+    QImage m_image;
+};
 
 IconProvider::IconProvider()
-  : QQuickImageProvider(QQuickImageProvider::Pixmap)
+  : m_cache(MemoryCacheBytes)
+  , m_diskCacheDir(QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) +
+                   QLatin1String("/grefsen/icons/"))
 {
-    XdgIcon::setThemeName(QStringLiteral("oxygen")); // TODO make configurable
-    qDebug() << "theme is" << QIcon::themeName() << "paths" << QIcon::themeSearchPaths()
+    QSettings settings;
+    settings.beginGroup(QStringLiteral("icons"));
+    XdgIcon::setThemeName(settings.value(QStringLiteral("theme"), QStringLiteral("oxygen")).toString());
+    m_themeName = QIcon::themeName();
+    m_index = new IconIndex(m_themeName);
+    qDebug() << "theme is" << m_themeName << "paths" << QIcon::themeSearchPaths()
              << "default icon" << XdgIcon::defaultApplicationIconName();
+    QDir().mkpath(m_diskCacheDir);
+    m_pool.setMaxThreadCount(2);
+    m_pool.start([this]() { pruneDiskCache(); });
+}
+
+IconProvider::~IconProvider()
+{
+    m_pool.waitForDone();
+    delete m_index;
 }
 
-QPixmap IconProvider::requestPixmap(const QString &id, QSize *size, const QSize &requestedSize)
+QQuickImageResponse *IconProvider::requestImageResponse(const QString &id, const QSize &requestedSize)
+{
+    return new IconResponse(this, &m_pool, id, requestedSize);
+}
+
+QImage IconProvider::image(const QString &id, const QSize &requestedSize)
 {
 //qDebug() << id << requestedSize;
-    // absolute path: just load the image
-    if (id.startsWith('/')) {
-        QPixmap ret(id);
-        if (ret.width() > requestedSize.width() || ret.height() > requestedSize.height())
-            ret = ret.scaled(requestedSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
-        if (size)
-            *size = ret.size();
-        return ret;
+    QSize size = requestedSize;
+    if (size.width() <= 0 || size.height() <= 0)
+        size = DefaultIconSize;
+    const QString key = id + QLatin1Char('@') + QString::number(size.width()) +
+            QLatin1Char('x') + QString::number(size.height());
+    {
+        QMutexLocker lock(&m_cacheMutex);
+        if (QImage *cached = m_cache.object(key))
+            return *cached;
+    }
+
+    // absolute path: just load the image; otherwise the index usually knows where it is
+    QString path = id.startsWith('/') ? id : m_index->lookup(id, qMax(size.width(), size.height()));
+    const QString cachePath = diskCachePath(path.isEmpty() ? id : path, size);
+    QImage ret(cachePath);
+    if (!ret.isNull())
+        touch(cachePath);
+    // the default icon stands in for a missing one only until the theme has it; not worth a file
+    bool fallback = false;
+    if (ret.isNull()) {
+        if (!path.isEmpty()) {
+            QImageReader reader(path);
+            QSize sourceSize = reader.size();
+            if (sourceSize.width() > size.width() || sourceSize.height() > size.height())
+                reader.setScaledSize(sourceSize.scaled(size, Qt::KeepAspectRatio));
+            ret = reader.read();
+        } else if (!m_index->isReady()) {
+            ret = loadFromTheme(id, size, &fallback);
+        } else {
+            qWarning() << "failed to find icon" << id;
+            fallback = true;
+            QString fallbackPath = m_index->lookup(XdgIcon::defaultApplicationIconName(), qMax(size.width(), size.height()));
+            if (fallbackPath.isEmpty())
+                return ret;
+            QImageReader reader(fallbackPath);
+            reader.setScaledSize(reader.size().scaled(size, Qt::KeepAspectRatio));
+            ret = reader.read();
+        }
+        if (ret.isNull())
+            return ret;
+        if (ret.width() > size.width() || ret.height() > size.height())
+            ret = ret.scaled(size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+        ret = ret.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+        if (!fallback) {
+            QSaveFile f(cachePath);
+            if (!f.open(QIODevice::WriteOnly) || !ret.save(&f, "PNG") || !f.commit())
+                qWarning() << "failed to write icon cache" << cachePath;
+            else
+                removeOtherVersions(cachePath);
+        }
+    } else {
+        ret = ret.convertToFormat(QImage::Format_ARGB32_Premultiplied);
     }
+
+    QMutexLocker lock(&m_cacheMutex);
+    m_cache.insert(key, new QImage(ret), int(ret.sizeInBytes()));
+    return ret;
+}
+
+// the slow way, until the index is ready
+QImage IconProvider::loadFromTheme(const QString &id, const QSize &size, bool *fallback)
+{
+    QMutexLocker lock(&themeMutex);
     // main strategy: QIcon usually knows how to find it
     QIcon icon = QIcon::fromTheme(id);
 //    QIcon icon = XdgIcon::fromTheme(id, XdgIcon::defaultApplicationIcon()); // often not working well
     // fall back to /usr/share/pixmaps if nothing found yet
     if (icon.isNull()) {
         QStringList p = UsrSharePixmaps.entryList({id + "*"}, QDir::Files);
-        if (!p.isEmpty()) {
-            QPixmap ret(UsrSharePixmaps.filePath(p.first()));
-            if (ret.width() > requestedSize.width() || ret.height() > requestedSize.height())
-                ret = ret.scaled(requestedSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
-            if (size)
-                *size = ret.size();
-            return ret;
-        }
+        if (!p.isEmpty())
+            return QImage(UsrSharePixmaps.filePath(p.first()));
     }
     // default app icon if all else fails
     if (icon.isNull()) {
         qWarning() << "failed to find icon" << id;
+        *fallback = true;
         icon = QIcon::fromTheme(XdgIcon::defaultApplicationIconName());
     }
-    QPixmap ret = icon.pixmap(requestedSize);
-    if (size)
-        *size = ret.size();
-    return ret;
+    return icon.pixmap(size, 1.0).toImage();
+}
+
+// <hash of the name or path and size>-<hash of the file's modification time or the theme name>,
+// so that a newer version of the same icon replaces the older one
+QString IconProvider::diskCachePath(const QString &idOrPath, const QSize &size) const
+{
+    const QByteArray key = idOrPath.toUtf8() + '@' + QByteArray::number(size.width()) + 'x' + QByteArray::number(size.height());
+    const QByteArray version = idOrPath.startsWith('/') ?
+            QByteArray::number(QFileInfo(idOrPath).lastModified().toMSecsSinceEpoch()) : m_themeName.toUtf8();
+    return m_diskCacheDir + QString::fromLatin1(QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex()) +
+            QLatin1Char('-') + QString::fromLatin1(QCryptographicHash::hash(version, QCryptographicHash::Sha1).toHex().left(8)) +
+            QLatin1String(".png");
+}
+
+void IconProvider::removeOtherVersions(const QString &cachePath) const
+{
+    const QFileInfo info(cachePath);
+    QDir dir(info.path());
+    const QString prefix = info.fileName().section(QLatin1Char('-'), 0, 0);
+    const QStringList files = dir.entryList(QStringList() << prefix + QLatin1String("-*"), QDir::Files);
+    for (const QString &file : files)
+        if (file != info.fileName())
+            dir.remove(file);
+}
+
+// the modification time of a cached file is when it was last used; not more often than daily
+void IconProvider::touch(const QString &cachePath) const
+{
+    const QDateTime now = QDateTime::currentDateTime();
+    if (QFileInfo(cachePath).lastModified().daysTo(now) < 1)
+        return;
+    QFile f(cachePath);
+    if (f.open(QIODevice::ReadWrite))
+        f.setFileTime(now, QFileDevice::FileModificationTime);
+}
+
+// on a loader thread, at startup
+void IconProvider::pruneDiskCache() const
+{
+    const QDateTime oldest = QDateTime::currentDateTime().addDays(-DiskCacheMaxAgeDays);
+    QDir dir(m_diskCacheDir);
+    const QFileInfoList files = dir.entryInfoList(QStringList() << QStringLiteral("*.png"), QDir::Files);
+    int removed = 0;
+    for (const QFileInfo &file : files) {
+        if (file.lastModified() < oldest && dir.remove(file.fileName()))
+            ++removed;
+    }
+    if (removed)
+        qDebug() << "removed" << removed << "icons unused for" << DiskCacheMaxAgeDays << "days from" << m_diskCacheDir;
 }
+
+#include "iconprovider.moc"
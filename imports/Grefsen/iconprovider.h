@@ -1,17 +1,54 @@
 #ifndef ICONPROVIDER_H
 #define ICONPROVIDER_H
 
+#include <QCache>
+#include <QImage>
+#include <QMutex>
 #include <QQuickImageProvider>
-#include <QDir>
+#include <QThreadPool>
 
-class IconProvider : public QQuickImageProvider
+class IconIndex;
+
+/*!
+    Provides image://icon/ URLs: an icon name from the theme, or an absolute path.
+
+    Icons are loaded on a small thread pool. Decoded, scaled images are kept
+    in an in-memory LRU cache and also written as PNG files to
+    ~/.cache/grefsen/icons, so that an SVG icon is only rendered once per size;
+    the default icon shown for a missing one is kept in memory only. A new
+    version of an icon file or theme replaces the old file, and files not
+    used for 60 days are removed at startup.
+    Names are resolved via IconIndex once it's ready; the theme comes from
+    the [icons] section of grefsen.conf.
+    The size in the key is the requested size in pixels, which Qt Quick has
+    already multiplied by the device pixel ratio. The images go into the
+    scene graph's texture atlas like those of any other image provider.
+*/
+class IconProvider : public QQuickAsyncImageProvider
 {
 public:
     IconProvider();
+    ~IconProvider();
+
+    QQuickImageResponse *requestImageResponse(const QString &id, const QSize &requestedSize) Q_DECL_OVERRIDE;
+
+    QImage image(const QString &id, const QSize &requestedSize);
+
+protected:
+    QImage loadFromTheme(const QString &id, const QSize &size, bool *fallback);
+    QString diskCachePath(const QString &idOrPath, const QSize &size) const;
+    void removeOtherVersions(const QString &cachePath) const;
+    void touch(const QString &cachePath) const;
+    void pruneDiskCache() const;
 
-    QPixmap requestPixmap(const QString &id, QSize *size, const QSize &requestedSize) Q_DECL_OVERRIDE;
 protected:
 //    QDir m_usrSharePixmaps = QDir("/usr/share/pixmaps");
+    QThreadPool m_pool;
+    QMutex m_cacheMutex;
+    QCache<QString, QImage> m_cache; // cost is in bytes
+    QString m_diskCacheDir;
+    QString m_themeName;
+    IconIndex *m_index;
 };
 
 #endif // ICONPROVIDER_H
@@ -1,17 +1,28 @@
 #include "launchermodel.h"
+#include "menucache.h"
+#include <QCoreApplication>
 #include <QDebug>
-#include <QJSEngine>
-#include <XmlHelper>
+#include <QDomElement>
+#include <QElapsedTimer>
+#include <QSettings>
+#include <QThread>
 #include <XdgDesktopFile>
 #include <XdgMenu>
 
-LauncherModel::LauncherModel(QJSEngine *engine, QObject *parent)
-  : QObject(parent)
-  , m_engine(engine)
-  , m_root(engine->newObject())
-  , m_allApps(engine->newArray())
+static const QString LaunchCountsGroup = QStringLiteral("launchCounts");
+static const int PopulateBatchSize = 50; // rows inserted per event loop iteration while loading
+
+static LauncherTree loadLauncherTree()
 {
+    QElapsedTimer timer;
+    timer.start();
+    LauncherTree ret;
     QString menuFile = XdgMenu::getMenuFileName();
+    MenuCache cache(menuFile);
+    if (cache.load(&ret)) {
+        qDebug() << "read menu cache:" << cache.filePath() << ret.apps.count() << "apps in" << timer.elapsed() << "ms";
+        return ret;
+    }
     XdgMenu xdgMenu;
     xdgMenu.setLogDir("/tmp");
     xdgMenu.setEnvironments(QStringList() << "X-GREFSEN" << "Grefsen");  // TODO what's that for?
@@ -19,11 +30,157 @@ LauncherModel::LauncherModel(QJSEngine *engine, QObject *parent)
     bool res = xdgMenu.read(menuFile);
     if (!res)
         qWarning() << "Parse error" << xdgMenu.errorString();
-    m_dom = xdgMenu.xml().documentElement();
-    qDebug() << "read XML:" << menuFile << xdgMenu.menuFileName() << m_dom.tagName();
+    QDomElement dom = xdgMenu.xml().documentElement();
+    qDebug() << "read XML:" << menuFile << xdgMenu.menuFileName() << dom.tagName() << "in" << timer.elapsed() << "ms";
+    ret = LauncherTree::fromXdgMenu(dom);
+    // Keywords aren't in the AppLink elements; get them for the search index
+    QHash<QString, QStringList> keywords;
+    for (LauncherApp &app : ret.apps) {
+        auto found = keywords.constFind(app.desktopFile);
+        if (found == keywords.constEnd()) {
+            XdgDesktopFile dtf;
+            if (dtf.load(app.desktopFile))
+                found = keywords.insert(app.desktopFile,
+                    dtf.localizedValue(QStringLiteral("Keywords")).toString().split(QLatin1Char(';'), Qt::SkipEmptyParts));
+            else
+                found = keywords.insert(app.desktopFile, QStringList());
+        }
+        app.keywords = *found;
+    }
+    if (res)
+        cache.save(ret);
+    return ret;
+}
+
+static QHash<QString, int> loadLaunchCounts()
+{
+    QHash<QString, int> ret;
+    QSettings settings;
+    settings.beginGroup(LaunchCountsGroup);
+    const QStringList ids = settings.childKeys();
+    for (const QString &id : ids)
+        ret.insert(id, settings.value(id).toInt());
+    return ret;
+}
+
+template <typename T>
+static bool isSubsequence(const QVector<T> &sub, const QVector<T> &seq)
+{
+    int j = 0;
+    for (int i = 0; i < seq.count() && j < sub.count(); ++i)
+        if (seq.at(i) == sub.at(j))
+            ++j;
+    return j == sub.count();
+}
+
+LauncherModel::LauncherModel(QObject *parent)
+  : QAbstractListModel(parent)
+{
+    // XdgMenu::read(), the desktop file scan and indexing for search happen
+    // on a worker thread; the result is handed back via a queued call
+    m_loaderThread = QThread::create([this]() {
+        LauncherTree tree = loadLauncherTree();
+        LauncherSearch search;
+        search.build(tree.apps, loadLaunchCounts());
+        QMetaObject::invokeMethod(this, [this, tree, search]() { setTree(tree, search); }, Qt::QueuedConnection);
+    });
+    connect(m_loaderThread, &QThread::finished, m_loaderThread, &QObject::deleteLater);
+    connect(m_loaderThread, &QObject::destroyed, this, [this]() { m_loaderThread = nullptr; });
+    m_loaderThread->start(QThread::LowPriority);
+}
+
+LauncherModel::~LauncherModel()
+{
+    if (m_loaderThread)
+        m_loaderThread->wait();
+}
+
+int LauncherModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_rows.count();
+}
+
+QVariant LauncherModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_rows.count())
+        return QVariant();
+    const LauncherEntryRef &ref = m_rows.at(index.row());
+    if (ref.isMenu) {
+        const LauncherMenuNode &menu = m_tree.menus.at(ref.index);
+        switch (role) {
+        case Qt::DisplayRole:
+        case TitleRole:
+            return menu.title;
+        case IconRole:
+            return menu.icon;
+        case IsMenuRole:
+            return true;
+        default:
+            return QVariant();
+        }
+    }
+    const LauncherApp &app = m_tree.apps.at(ref.index);
+    switch (role) {
+    case Qt::DisplayRole:
+    case TitleRole:
+        return app.title;
+    case IconRole:
+        return app.icon;
+    case ExecRole:
+        return app.exec;
+    case DesktopFileRole:
+        return app.desktopFile;
+    case IsMenuRole:
+        return false;
+    default:
+        return QVariant();
+    }
+}
+
+QHash<int, QByteArray> LauncherModel::roleNames() const
+{
+    static const QHash<int, QByteArray> roles {
+        { TitleRole, "title" },
+        { IconRole, "icon" },
+        { ExecRole, "exec" },
+        { DesktopFileRole, "desktopFile" },
+        { IsMenuRole, "isMenu" }
+    };
+    return roles;
+}
+
+void LauncherModel::setTree(const LauncherTree &tree, const LauncherSearch &search)
+{
+    m_tree = tree;
+    m_search = search;
+    if (m_substringFilter.isEmpty()) {
+        populate();
+    } else {
+        setRows(searchRows(m_substringFilter));
+        m_loading = false;
+        emit loadingChanged();
+    }
+}
 
-    build(m_root, m_dom);
-    m_list = m_root;
+// the root menu, a batch of rows at a time, so that a long menu doesn't hold up a frame;
+// unless another menu or a search has been opened meanwhile (openMenu(0) shows it all at once)
+void LauncherModel::populate()
+{
+    const QVector<LauncherEntryRef> items = m_tree.menus.isEmpty() ? QVector<LauncherEntryRef>() : m_tree.menus.first().items;
+    if (m_menu == 0 && m_rows.count() < items.count()) {
+        const int first = m_rows.count();
+        const int count = qMin(PopulateBatchSize, int(items.count()) - first);
+        beginInsertRows(QModelIndex(), first, first + count - 1);
+        m_rows += items.mid(first, count);
+        endInsertRows();
+        emit applicationsChanged();
+        if (m_rows.count() < items.count()) {
+            QMetaObject::invokeMethod(this, &LauncherModel::populate, Qt::QueuedConnection);
+            return;
+        }
+    }
+    m_loading = false;
+    emit loadingChanged();
 }
 
 void LauncherModel::setSubstringFilter(QString substringFilter)
@@ -38,27 +195,27 @@ void LauncherModel::setSubstringFilter(QString substringFilter)
         reset();
         return;
     }
-    m_list = m_engine->newObject();
-    m_list.setProperty(QStringLiteral("items"), findSubstring(QStringLiteral("title"), m_substringFilter));
-    emit applicationsChanged();
+    m_menu = -1;
+    setRows(searchRows(m_substringFilter));
 }
 
 void LauncherModel::reset()
 {
-    m_list = m_root;
-    emit applicationsChanged();
+    openMenu(0);
 }
 
-void LauncherModel::select(QJSValue sel)
+void LauncherModel::select(int row)
 {
-    QString title = sel.property(QStringLiteral("title")).toString();
-    qDebug() << title;
-    if (sel.hasOwnProperty(QStringLiteral("exec"))) {
-//qDebug() << "exec" << sel.property(QStringLiteral("exec")).toString();
-        exec(sel.property(QStringLiteral("desktopFile")).toString());
-        reset();
+    if (row < 0 || row >= m_rows.count())
+        return;
+    LauncherEntryRef ref = m_rows.at(row);
+    if (ref.isMenu) {
+        qDebug() << m_tree.menus.at(ref.index).title;
+        openMenu(ref.index);
     } else {
-        openSubmenu(title);
+        qDebug() << m_tree.apps.at(ref.index).title;
+        exec(m_tree.apps.at(ref.index).desktopFile);
+        reset();
     }
 }
 
@@ -68,7 +225,24 @@ void LauncherModel::exec(QString desktopFilePath)
     dtf.load(desktopFilePath);
 //qDebug() << desktopFilePath << dtf;
     if (dtf.isValid()) {
-        bool ok = dtf.startDetached();
+        bool ok = false;
+        // the compositor's launch service has the environment ready; terminal apps need libqtxdg to find a terminal
+        QObject *launchService = qApp->property("launchService").value<QObject *>();
+        QStringList command = dtf.expandExecString();
+        if (launchService && !command.isEmpty() && !dtf.value(QStringLiteral("Terminal")).toBool()) {
+            const QString program = command.takeFirst();
+            qint64 pid = -1;
+            QMetaObject::invokeMethod(launchService, "launch", Q_RETURN_ARG(qint64, pid), Q_ARG(QString, program),
+                                      Q_ARG(QStringList, command), Q_ARG(QString, dtf.value(QStringLiteral("Path")).toString()));
+            ok = pid > 0;
+        } else {
+            ok = dtf.startDetached();
+        }
+        if (ok) {
+            QSettings settings;
+            settings.beginGroup(LaunchCountsGroup);
+            settings.setValue(LauncherSearch::desktopFileId(desktopFilePath), m_search.recordLaunch(desktopFilePath));
+        }
         if (Q_UNLIKELY(!ok))
             emit execFailed(tr("failed to exec '%s'", dtf.value(QStringLiteral("exec")).toString().toLocal8Bit().constData()));
     } else {
@@ -78,79 +252,79 @@ void LauncherModel::exec(QString desktopFilePath)
 
 void LauncherModel::openSubmenu(QString title)
 {
-    m_list = findFirst(QStringLiteral("title"), title, applicationMenu());
-    emit applicationsChanged();
-}
-
-void LauncherModel::build(QJSValue in, const QDomElement &xml)
-{
-    QJSValue array = m_engine->newArray();
-    in.setProperty(QStringLiteral("items"), array);
-    DomElementIterator it(xml, QString());
-    while(it.hasNext())
-    {
-        QDomElement xml = it.next();
-
-        if (xml.tagName() == "Menu")
-            appendMenu(array, xml);
-
-        else if (xml.tagName() == "AppLink")
-            appendApp(array, xml);
-
-        else if (xml.tagName() == "Separator")
-            qDebug() << "separator";
+    for (const LauncherEntryRef &ref : qAsConst(m_rows)) {
+        if (ref.isMenu && m_tree.menus.at(ref.index).title == title) {
+            openMenu(ref.index);
+            return;
+        }
     }
 }
 
-void LauncherModel::appendMenu(QJSValue in, const QDomElement &xml)
+void LauncherModel::openMenu(int menuIndex)
 {
-    QString title = xml.attribute(QStringLiteral("title"));
-    QString icon = xml.attribute(QStringLiteral("icon"));
-    int idx = in.property(QStringLiteral("length")).toInt();
-//    qDebug() << in.property(QStringLiteral("title")).toString() << ":" << title << icon << idx;
-    QJSValue menu = m_engine->newObject();
-    menu.setProperty(QStringLiteral("title"), title);
-    menu.setProperty(QStringLiteral("icon"), icon);
-    in.setProperty(idx, menu);
-    build(menu, xml);
+    m_menu = menuIndex;
+    setRows(menuIndex < m_tree.menus.count() ? m_tree.menus.at(menuIndex).items : QVector<LauncherEntryRef>());
 }
 
-void LauncherModel::appendApp(QJSValue in, const QDomElement &xml)
+void LauncherModel::setRows(const QVector<LauncherEntryRef> &rows)
 {
-    QString title = xml.attribute(QStringLiteral("title"));
-    QString icon = xml.attribute(QStringLiteral("icon"));
-    int idx = in.property(QStringLiteral("length")).toInt();
-//    qDebug() << in.property(QStringLiteral("title")).toString() << ":" << title << icon << idx;
-    QJSValue item = m_engine->newObject();
-    item.setProperty(QStringLiteral("title"), title);
-    item.setProperty(QStringLiteral("icon"), icon);
-    item.setProperty(QStringLiteral("exec"), xml.attribute(QStringLiteral("exec")));
-    item.setProperty(QStringLiteral("desktopFile"), xml.attribute(QStringLiteral("desktopFile")));
-    in.setProperty(idx, item);
-    m_allApps.setProperty(m_allAppsCount++, item);
-}
-
-QJSValue LauncherModel::findFirst(QString key, QString value, QJSValue array)
-{
-    int i = 0;
-    QJSValue next = array.property(i);
-    while (!next.isUndefined()) {
-        if (next.property(key).toString() == value)
-            return next;
-        next = array.property(++i);
+    if (rows == m_rows)
+        return;
+    if (isSubsequence(rows, m_rows)) {
+        // narrowing: remove each run of rows that is no longer present, from the end
+        int j = rows.count() - 1;
+        for (int i = m_rows.count() - 1; i >= 0; ) {
+            if (j >= 0 && m_rows.at(i) == rows.at(j)) {
+                --i;
+                --j;
+                continue;
+            }
+            int last = i;
+            while (i >= 0 && !(j >= 0 && m_rows.at(i) == rows.at(j)))
+                --i;
+            beginRemoveRows(QModelIndex(), i + 1, last);
+            m_rows.remove(i + 1, last - i);
+            endRemoveRows();
+        }
+    } else if (isSubsequence(m_rows, rows)) {
+        // widening: insert each run of new rows where it belongs
+        int i = 0;
+        for (int j = 0; j < rows.count(); ) {
+            if (i < m_rows.count() && m_rows.at(i) == rows.at(j)) {
+                ++i;
+                ++j;
+                continue;
+            }
+            int first = j;
+            while (j < rows.count() && !(i < m_rows.count() && m_rows.at(i) == rows.at(j)))
+                ++j;
+            beginInsertRows(QModelIndex(), i, i + j - first - 1);
+            for (int k = first; k < j; ++k)
+                m_rows.insert(i++, rows.at(k));
+            endInsertRows();
+        }
+    } else {
+        // e.g. entering a submenu: nothing in common
+        if (!m_rows.isEmpty()) {
+            beginRemoveRows(QModelIndex(), 0, m_rows.count() - 1);
+            m_rows.clear();
+            endRemoveRows();
+        }
+        if (!rows.isEmpty()) {
+            beginInsertRows(QModelIndex(), 0, rows.count() - 1);
+            m_rows = rows;
+            endInsertRows();
+        }
     }
-    return QJSValue();
+    emit applicationsChanged();
 }
 
-QJSValue LauncherModel::findSubstring(QString key, QString substr)
+QVector<LauncherEntryRef> LauncherModel::searchRows(const QString &query)
 {
-    QJSValue ret = m_engine->newArray();
-    int i = 0, ri = 0;
-    QJSValue next = m_allApps.property(i);
-    while (!next.isUndefined()) {
-        if (next.property(key).toString().contains(substr, Qt::CaseInsensitive))
-            ret.setProperty(ri++, next);
-        next = m_allApps.property(++i);
-    }
+    QVector<LauncherEntryRef> ret;
+    const QVector<int> apps = m_search.search(query);
+    ret.reserve(apps.count());
+    for (int app : apps)
+        ret.append({false, app});
     return ret;
 }
@@ -1,55 +1,80 @@
 #ifndef LAUNCHERMODEL_H
 #define LAUNCHERMODEL_H
 
-#include <QDomElement>
-#include <QJSValue>
-#include <QObject>
+#include <QAbstractListModel>
+#include "launchersearch.h"
+#include "launchertree.h"
 
+class QThread;
 class XdgDesktopFile;
 
-class LauncherModel : public QObject
+/*!
+    The application menu as a list model: either the contents of one menu
+    (the root menu by default), or the apps which match substringFilter.
+    Filter results are ranked by LauncherSearch. Changing the filter or
+    opening a submenu inserts and removes rows rather than resetting the model.
+    The menu is loaded on a worker thread; the root menu's rows are then
+    inserted a batch per event loop iteration, while \c loading is true.
+*/
+class LauncherModel : public QAbstractListModel
 {
     Q_OBJECT
-    Q_PROPERTY(QJSValue allApplications READ allApplications NOTIFY applicationsChanged)
-    Q_PROPERTY(QJSValue applicationMenu READ applicationMenu NOTIFY applicationsChanged)
     Q_PROPERTY(QString substringFilter READ substringFilter WRITE setSubstringFilter NOTIFY substringFilterChanged)
+    Q_PROPERTY(bool loading READ loading NOTIFY loadingChanged)
+    Q_PROPERTY(int count READ count NOTIFY applicationsChanged)
 
 
 public:
-    explicit LauncherModel(QJSEngine *engine, QObject *parent = 0);
-    QJSValue allApplications() { return m_allApps; }
-    QJSValue applicationMenu() { return m_list.property(QStringLiteral("items")); }
+    enum Roles {
+        TitleRole = Qt::UserRole + 1,
+        IconRole,
+        ExecRole,
+        DesktopFileRole,
+        IsMenuRole
+    };
+    Q_ENUM(Roles)
+
+    explicit LauncherModel(QObject *parent = 0);
+    ~LauncherModel();
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const Q_DECL_OVERRIDE;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const Q_DECL_OVERRIDE;
+    QHash<int, QByteArray> roleNames() const Q_DECL_OVERRIDE;
+    int count() const { return m_rows.count(); }
 
     QString substringFilter() const { return m_substringFilter; }
     void setSubstringFilter(QString substringFilter);
 
+    bool loading() const { return m_loading; }
+
 signals:
     void applicationsChanged();
     void substringFilterChanged();
+    void loadingChanged();
     void execFailed(QString error);
 
 public slots:
     void reset();
-    void select(QJSValue sel);
+    void select(int row);
     void exec(QString desktopFilePath);
     void openSubmenu(QString title);
 
 
 protected:
-    void build(QJSValue in, const QDomElement& xml);
-    void appendMenu(QJSValue in, const QDomElement& xml);
-    void appendApp(QJSValue in, const QDomElement &xml);
-    QJSValue findFirst(QString key, QString value, QJSValue array);
-    QJSValue findSubstring(QString key, QString substr);
+    void setTree(const LauncherTree &tree, const LauncherSearch &search);
+    void populate();
+    void openMenu(int menuIndex);
+    void setRows(const QVector<LauncherEntryRef> &rows);
+    QVector<LauncherEntryRef> searchRows(const QString &query);
 
 protected:
 //    static QList<XdgDesktopFile *> m_allFiles;
-    QJSEngine *m_engine;
-    QDomElement m_dom;
-    QJSValue m_root;
-    QJSValue m_list;
-    QJSValue m_allApps;
-    int m_allAppsCount = 0;
+    QThread *m_loaderThread = nullptr;
+    LauncherTree m_tree;
+    LauncherSearch m_search;
+    QVector<LauncherEntryRef> m_rows;
+    int m_menu = 0; // index of the menu being shown, or -1 while filtering
+    bool m_loading = true;
     QString m_substringFilter;
 };
 
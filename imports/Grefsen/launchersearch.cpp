@@ -0,0 +1,196 @@
+#include "launchersearch.h"
+#include "launchertree.h"
+
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+
+static inline quint64 trigramKey(QChar a, QChar b, QChar c)
+{
+    return (quint64(a.unicode()) << 32) | (quint64(b.unicode()) << 16) | quint64(c.unicode());
+}
+
+static void appendTrigrams(const QString &text, QVector<quint64> &out)
+{
+    for (int i = 0; i + 2 < text.length(); ++i)
+        out.append(trigramKey(text.at(i), text.at(i + 1), text.at(i + 2)));
+}
+
+// sorted and unique, so that two sets can be compared with std::set_difference
+static QVector<quint64> trigrams(const QString &text)
+{
+    QVector<quint64> ret;
+    appendTrigrams(text, ret);
+    std::sort(ret.begin(), ret.end());
+    ret.erase(std::unique(ret.begin(), ret.end()), ret.end());
+    return ret;
+}
+
+static QString programName(const QString &exec)
+{
+    const QStringList args = exec.split(QLatin1Char(' '), Qt::SkipEmptyParts);
+    for (const QString &arg : args) {
+        if (arg == QLatin1String("env") || arg.contains(QLatin1Char('=')))
+            continue;
+        return arg.mid(arg.lastIndexOf(QLatin1Char('/')) + 1);
+    }
+    return QString();
+}
+
+QString LauncherSearch::fold(const QString &text)
+{
+    QString decomposed = text.normalized(QString::NormalizationForm_KD);
+    QString ret;
+    ret.reserve(decomposed.length());
+    for (QChar c : decomposed)
+        if (!c.isMark())
+            ret.append(c);
+    return ret.toCaseFolded();
+}
+
+QString LauncherSearch::desktopFileId(const QString &desktopFile)
+{
+    return desktopFile.mid(desktopFile.lastIndexOf(QLatin1Char('/')) + 1);
+}
+
+void LauncherSearch::build(const QVector<LauncherApp> &apps, const QHash<QString, int> &launchCounts)
+{
+    m_entries.clear();
+    m_index.clear();
+    QHash<QString, int> seen;
+    for (int i = 0; i < apps.count(); ++i) {
+        const LauncherApp &app = apps.at(i);
+        // the same app can appear in several menus, but should be found only once
+        QString id = desktopFileId(app.desktopFile);
+        if (seen.contains(id))
+            continue;
+        seen.insert(id, i);
+        Entry e;
+        e.title = fold(app.title);
+        e.genericName = fold(app.genericName);
+        for (const QString &keyword : app.keywords)
+            e.keywords += QLatin1Char(';') + fold(keyword);
+        e.program = fold(programName(app.exec));
+        e.id = id;
+        e.app = i;
+        e.launches = launchCounts.value(id);
+
+        QVector<quint64> tris;
+        appendTrigrams(e.title, tris);
+        appendTrigrams(e.genericName, tris);
+        appendTrigrams(e.keywords, tris);
+        appendTrigrams(e.program, tris);
+        std::sort(tris.begin(), tris.end());
+        tris.erase(std::unique(tris.begin(), tris.end()), tris.end());
+        int entry = m_entries.count();
+        for (quint64 t : tris)
+            m_index[t].append(entry);
+        m_entries.append(e);
+    }
+    m_lastQuery.clear();
+    m_lastTrigrams.clear();
+    m_hits.fill(0, m_entries.count());
+    m_candidates.clear();
+}
+
+void LauncherSearch::addTrigrams(const QVector<quint64> &trigrams, int delta)
+{
+    for (quint64 t : trigrams) {
+        const auto postings = m_index.constFind(t);
+        if (postings == m_index.constEnd())
+            continue;
+        for (int entry : *postings) {
+            if (m_hits[entry] == 0 && delta > 0)
+                m_candidates.append(entry);
+            m_hits[entry] += delta;
+        }
+    }
+}
+
+QVector<int> LauncherSearch::search(const QString &query)
+{
+    const QString q = fold(query).simplified();
+    QVector<int> ret;
+    if (q.isEmpty())
+        return ret;
+
+    // update the hit counts by the difference between the old and new query
+    // rather than starting over: typing usually adds or removes just one trigram
+    if (q != m_lastQuery) {
+        QVector<quint64> tris = trigrams(q);
+        QVector<quint64> added, removed;
+        std::set_difference(tris.cbegin(), tris.cend(), m_lastTrigrams.cbegin(), m_lastTrigrams.cend(), std::back_inserter(added));
+        std::set_difference(m_lastTrigrams.cbegin(), m_lastTrigrams.cend(), tris.cbegin(), tris.cend(), std::back_inserter(removed));
+        // prune before adding: an entry that drops to 0 and comes back must be appended only once
+        addTrigrams(removed, -1);
+        m_candidates.erase(std::remove_if(m_candidates.begin(), m_candidates.end(),
+                                          [this](int entry) { return m_hits.at(entry) <= 0; }),
+                           m_candidates.end());
+        addTrigrams(added, 1);
+        m_lastTrigrams = tris;
+        m_lastQuery = q;
+    }
+
+    const QString wordPrefix = QLatin1Char(' ') + q;
+    const QString keywordPrefix = QLatin1Char(';') + q;
+    QVector<QPair<int, int> > scored; // score, entry
+    auto consider = [&](int entry) {
+        int s = score(m_entries.at(entry), q, wordPrefix, keywordPrefix, m_hits.at(entry));
+        if (s > 0)
+            scored.append(qMakePair(s, entry));
+    };
+    if (m_lastTrigrams.isEmpty()) {
+        // one or two characters: no trigrams, but a scan is cheap enough
+        for (int i = 0; i < m_entries.count(); ++i)
+            consider(i);
+    } else {
+        for (int entry : qAsConst(m_candidates))
+            consider(entry);
+    }
+
+    std::sort(scored.begin(), scored.end(), [this](const QPair<int, int> &a, const QPair<int, int> &b) {
+        if (a.first != b.first)
+            return a.first > b.first;
+        return m_entries.at(a.second).title < m_entries.at(b.second).title;
+    });
+    ret.reserve(scored.count());
+    for (const auto &s : qAsConst(scored))
+        ret.append(m_entries.at(s.second).app);
+    return ret;
+}
+
+int LauncherSearch::score(const Entry &entry, const QString &query, const QString &wordPrefix,
+                          const QString &keywordPrefix, int trigramHits) const
+{
+    int s = 0;
+    if (entry.title == query)
+        s = 1000;
+    else if (entry.title.startsWith(query))
+        s = 900;
+    else if (entry.title.contains(wordPrefix))
+        s = 800;
+    else if (entry.title.contains(query))
+        s = 600;
+    else if (entry.keywords.contains(keywordPrefix))
+        s = 500;
+    else if (entry.genericName.contains(query) || entry.program.startsWith(query))
+        s = 450;
+    else if (entry.keywords.contains(query))
+        s = 400;
+    else if (entry.program.contains(query))
+        s = 350;
+    else if (!m_lastTrigrams.isEmpty() && trigramHits * 2 >= m_lastTrigrams.count())
+        s = 300 * trigramHits / m_lastTrigrams.count(); // probably a typo
+    if (s == 0)
+        return 0;
+    return s + qMin(100, int(20 * std::log2(1 + entry.launches)));
+}
+
+int LauncherSearch::recordLaunch(const QString &desktopFile)
+{
+    QString id = desktopFileId(desktopFile);
+    for (Entry &e : m_entries)
+        if (e.id == id)
+            return ++e.launches;
+    return 0;
+}
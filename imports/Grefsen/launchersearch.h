@@ -0,0 +1,56 @@
+#ifndef LAUNCHERSEARCH_H
+#define LAUNCHERSEARCH_H
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+struct LauncherApp;
+
+/*!
+    Ranked, typo-tolerant search over the launcher's apps.
+
+    build() folds every title, GenericName, Keywords and the exec'd program
+    name to lowercase without diacritics, and indexes them by trigram. A
+    query's score combines the best kind of match (whole title, title prefix,
+    word prefix, substring, other fields, and finally the fraction of the
+    query's trigrams that the entry contains) with how often the app has been
+    launched. The per-entry trigram hit counts are kept between calls, so
+    when the query is extended or shortened by typing, only the trigrams that
+    were added or removed need to be looked up.
+*/
+class LauncherSearch
+{
+public:
+    void build(const QVector<LauncherApp> &apps, const QHash<QString, int> &launchCounts);
+    QVector<int> search(const QString &query);
+    int recordLaunch(const QString &desktopFile);
+
+    static QString desktopFileId(const QString &desktopFile);
+    static QString fold(const QString &text);
+
+protected:
+    struct Entry {
+        QString title;
+        QString genericName;
+        QString keywords;
+        QString program;
+        QString id;
+        int app = -1;
+        int launches = 0;
+    };
+
+    int score(const Entry &entry, const QString &query, const QString &wordPrefix,
+              const QString &keywordPrefix, int trigramHits) const;
+    void addTrigrams(const QVector<quint64> &trigrams, int delta);
+
+protected:
+    QVector<Entry> m_entries;
+    QHash<quint64, QVector<int> > m_index; // trigram -> entries which contain it
+    QString m_lastQuery;
+    QVector<quint64> m_lastTrigrams;
+    QVector<int> m_hits; // per entry: how many of m_lastTrigrams it contains
+    QVector<int> m_candidates; // entries whose hit count may be nonzero
+};
+
+#endif // LAUNCHERSEARCH_H
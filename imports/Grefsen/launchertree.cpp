@@ -0,0 +1,88 @@
+#include "launchertree.h"
+#include <QDebug>
+#include <QDomElement>
+#include <XmlHelper>
+
+LauncherTree LauncherTree::fromXdgMenu(const QDomElement &xml)
+{
+    LauncherTree ret;
+    ret.menus.append(LauncherMenuNode());
+    ret.build(0, xml);
+    return ret;
+}
+
+void LauncherTree::build(int menuIndex, const QDomElement &xml)
+{
+    DomElementIterator it(xml, QString());
+    while(it.hasNext())
+    {
+        QDomElement xml = it.next();
+
+        if (xml.tagName() == "Menu") {
+            LauncherMenuNode menu;
+            menu.title = xml.attribute(QStringLiteral("title"));
+            menu.icon = xml.attribute(QStringLiteral("icon"));
+            int idx = menus.count();
+            menus.append(menu);
+            menus[menuIndex].items.append({true, idx});
+            build(idx, xml);
+        }
+
+        else if (xml.tagName() == "AppLink") {
+            LauncherApp app;
+            app.title = xml.attribute(QStringLiteral("title"));
+            app.icon = xml.attribute(QStringLiteral("icon"));
+            app.exec = xml.attribute(QStringLiteral("exec"));
+            app.desktopFile = xml.attribute(QStringLiteral("desktopFile"));
+            app.genericName = xml.attribute(QStringLiteral("genericName"));
+            menus[menuIndex].items.append({false, int(apps.count())});
+            apps.append(app);
+        }
+
+        else if (xml.tagName() == "Separator")
+            qDebug() << "separator";
+    }
+}
+
+QDataStream &operator<<(QDataStream &out, const LauncherApp &app)
+{
+    return out << app.title << app.icon << app.exec << app.desktopFile << app.genericName << app.keywords;
+}
+
+QDataStream &operator>>(QDataStream &in, LauncherApp &app)
+{
+    return in >> app.title >> app.icon >> app.exec >> app.desktopFile >> app.genericName >> app.keywords;
+}
+
+QDataStream &operator<<(QDataStream &out, const LauncherEntryRef &ref)
+{
+    return out << ref.isMenu << qint32(ref.index);
+}
+
+QDataStream &operator>>(QDataStream &in, LauncherEntryRef &ref)
+{
+    qint32 index = -1;
+    in >> ref.isMenu >> index;
+    ref.index = index;
+    return in;
+}
+
+QDataStream &operator<<(QDataStream &out, const LauncherMenuNode &menu)
+{
+    return out << menu.title << menu.icon << menu.items;
+}
+
+QDataStream &operator>>(QDataStream &in, LauncherMenuNode &menu)
+{
+    return in >> menu.title >> menu.icon >> menu.items;
+}
+
+QDataStream &operator<<(QDataStream &out, const LauncherTree &tree)
+{
+    return out << tree.menus << tree.apps;
+}
+
+QDataStream &operator>>(QDataStream &in, LauncherTree &tree)
+{
+    return in >> tree.menus >> tree.apps;
+}
@@ -0,0 +1,63 @@
+#ifndef LAUNCHERTREE_H
+#define LAUNCHERTREE_H
+
+#include <QDataStream>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+class QDomElement;
+
+struct LauncherApp
+{
+    QString title;
+    QString icon;
+    QString exec;
+    QString desktopFile;
+    QString genericName;
+    QStringList keywords;
+};
+
+struct LauncherEntryRef
+{
+    bool isMenu = false;
+    int index = -1; // into LauncherTree::menus or LauncherTree::apps
+
+    bool operator==(const LauncherEntryRef &other) const { return isMenu == other.isMenu && index == other.index; }
+    bool operator!=(const LauncherEntryRef &other) const { return !(*this == other); }
+};
+
+struct LauncherMenuNode
+{
+    QString title;
+    QString icon;
+    QVector<LauncherEntryRef> items;
+};
+
+/*!
+    The application menu in a form that doesn't depend on QDom or a JS engine:
+    menus[0] is the root menu; every AppLink in the XDG menu becomes one
+    entry in the flat apps array, in document order.
+*/
+struct LauncherTree
+{
+    QVector<LauncherMenuNode> menus;
+    QVector<LauncherApp> apps;
+
+    bool isEmpty() const { return menus.isEmpty(); }
+    static LauncherTree fromXdgMenu(const QDomElement &xml);
+
+protected:
+    void build(int menuIndex, const QDomElement &xml);
+};
+
+QDataStream &operator<<(QDataStream &out, const LauncherApp &app);
+QDataStream &operator>>(QDataStream &in, LauncherApp &app);
+QDataStream &operator<<(QDataStream &out, const LauncherEntryRef &ref);
+QDataStream &operator>>(QDataStream &in, LauncherEntryRef &ref);
+QDataStream &operator<<(QDataStream &out, const LauncherMenuNode &menu);
+QDataStream &operator>>(QDataStream &in, LauncherMenuNode &menu);
+QDataStream &operator<<(QDataStream &out, const LauncherTree &tree);
+QDataStream &operator>>(QDataStream &in, LauncherTree &tree);
+
+#endif // LAUNCHERTREE_H
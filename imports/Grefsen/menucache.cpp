@@ -0,0 +1,100 @@
+#include "menucache.h"
+#include "launchertree.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QLocale>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <XdgDirs>
+
+static const quint32 CacheMagic = 0x47524d43; // "GRMC"
+static const quint32 CacheVersion = 2;
+
+static qint64 mtime(const QString &path)
+{
+    QFileInfo fi(path);
+    return fi.exists() ? fi.lastModified().toMSecsSinceEpoch() : -1;
+}
+
+static void stampDirectory(QList<QPair<QString, qint64> > &stamps, const QString &path)
+{
+    stamps.append(qMakePair(path, mtime(path)));
+    QDirIterator it(path, QDir::Dirs | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        QString dir = it.next();
+        stamps.append(qMakePair(dir, mtime(dir)));
+    }
+}
+
+MenuCache::MenuCache(const QString &menuFile)
+  : m_menuFile(menuFile)
+  , m_filePath(QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) +
+               QLatin1String("/grefsen/launchermenu.cache"))
+{
+}
+
+MenuCache::Stamps MenuCache::currentStamps() const
+{
+    Stamps ret;
+    ret.append(qMakePair(m_menuFile, mtime(m_menuFile)));
+    QStringList dataDirs = XdgDirs::dataDirs();
+    dataDirs.prepend(XdgDirs::dataHome(false));
+    for (const QString &dir : dataDirs) {
+        stampDirectory(ret, dir + QLatin1String("/applications"));
+        stampDirectory(ret, dir + QLatin1String("/desktop-directories"));
+    }
+    QStringList configDirs = XdgDirs::configDirs();
+    configDirs.prepend(XdgDirs::configHome(false));
+    for (const QString &dir : configDirs)
+        stampDirectory(ret, dir + QLatin1String("/menus"));
+    return ret;
+}
+
+bool MenuCache::load(LauncherTree *tree) const
+{
+    QFile f(m_filePath);
+    if (!f.open(QIODevice::ReadOnly))
+        return false;
+    QDataStream in(&f);
+    quint32 magic = 0, version = 0;
+    in >> magic >> version;
+    if (magic != CacheMagic || version != CacheVersion)
+        return false;
+    in.setVersion(QDataStream::Qt_6_0);
+    QString locale;
+    Stamps stamps;
+    in >> locale >> stamps;
+    if (locale != QLocale::system().name() || stamps != currentStamps()) {
+        qDebug() << "menu cache is stale:" << m_filePath;
+        return false;
+    }
+    LauncherTree ret;
+    in >> ret;
+    if (in.status() != QDataStream::Ok || ret.isEmpty()) {
+        qWarning() << "failed to read menu cache" << m_filePath;
+        return false;
+    }
+    *tree = ret;
+    return true;
+}
+
+bool MenuCache::save(const LauncherTree &tree) const
+{
+    QDir().mkpath(QFileInfo(m_filePath).absolutePath());
+    QSaveFile f(m_filePath);
+    if (!f.open(QIODevice::WriteOnly)) {
+        qWarning() << "failed to write menu cache" << m_filePath << f.errorString();
+        return false;
+    }
+    QDataStream out(&f);
+    out << CacheMagic << CacheVersion;
+    out.setVersion(QDataStream::Qt_6_0);
+    out << QLocale::system().name() << currentStamps() << tree;
+    return f.commit();
+}
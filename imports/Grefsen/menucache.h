@@ -0,0 +1,37 @@
+#ifndef MENUCACHE_H
+#define MENUCACHE_H
+
+#include <QList>
+#include <QPair>
+#include <QString>
+
+struct LauncherTree;
+
+/*!
+    A binary cache of the LauncherTree that XdgMenu would produce, so that
+    a warm start doesn't need to parse any XML. The cache is keyed on the
+    modification times of the menu file, the menu merge directories and
+    the directories that hold .desktop and .directory files (so adding,
+    removing or renaming an application invalidates it), and on the locale,
+    because titles are localized.
+*/
+class MenuCache
+{
+public:
+    explicit MenuCache(const QString &menuFile);
+
+    bool load(LauncherTree *tree) const;
+    bool save(const LauncherTree &tree) const;
+
+    QString filePath() const { return m_filePath; }
+
+protected:
+    typedef QList<QPair<QString, qint64> > Stamps;
+    Stamps currentStamps() const;
+
+protected:
+    QString m_menuFile;
+    QString m_filePath;
+};
+
+#endif // MENUCACHE_H
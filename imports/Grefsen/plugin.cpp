@@ -5,11 +5,11 @@
 
 #include "iconprovider.h"
 #include "launchermodel.h"
+#include "wallpaperprovider.h"
 
 Q_LOGGING_CATEGORY(lcRegistration, "grefsen.registration")
 
 static const char *ModuleName = "Grefsen";
-static QJSValue launcherModelSingleton;
 
 static QString ensureFinalSlash(const QString &path)
 {
@@ -33,13 +33,12 @@ static QJSValue environmentSingletonProvider(QQmlEngine *engine, QJSEngine *scri
     return v;
 }
 
-static QJSValue launcherModelSingletonProvider(QQmlEngine *engine, QJSEngine *scriptEngine)
+static QObject *launcherModelSingletonProvider(QQmlEngine *engine, QJSEngine *scriptEngine)
 {
     Q_UNUSED(engine)
+    Q_UNUSED(scriptEngine)
 
-    if (launcherModelSingleton.isUndefined())
-        launcherModelSingleton = scriptEngine->newQObject(new LauncherModel(scriptEngine));
-    return launcherModelSingleton;
+    return new LauncherModel;
 }
 
 class GrefsenPlugin : public QQmlExtensionPlugin
@@ -54,13 +53,14 @@ public:
         Q_UNUSED(engine)
         qCDebug(lcRegistration) << uri;
         engine->addImageProvider(QLatin1String("icon"), new IconProvider);
+        engine->addImageProvider(QLatin1String("wallpaper"), new WallpaperProvider);
     }
 
     virtual void registerTypes(const char *uri) {
         qCDebug(lcRegistration) << uri;
         Q_ASSERT(uri == QLatin1String(ModuleName));
         qmlRegisterSingletonType(ModuleName, 1, 0, "Env", environmentSingletonProvider);
-        qmlRegisterSingletonType(ModuleName, 1, 0, "LauncherModel", launcherModelSingletonProvider);
+        qmlRegisterSingletonType<LauncherModel>(ModuleName, 1, 0, "LauncherModel", launcherModelSingletonProvider);
     }
 };
 
@@ -0,0 +1,226 @@
+#include "wallpaperprovider.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <QImageReader>
+#include <QLoggingCategory>
+#include <QQuickWindow>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QScreen>
+#include <QStandardPaths>
+
+Q_LOGGING_CATEGORY(lcWallpaper, "grefsen.wallpaper")
+
+static const int JpegQuality = 95;
+
+class WallpaperLoader : public QObject, public QRunnable
+{
+    Q_OBJECT
+public:
+    WallpaperLoader(WallpaperProvider *provider, const QString &path, const QSize &requestedSize)
+      : m_provider(provider), m_path(path), m_requestedSize(requestedSize) { }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        emit done(m_provider->image(m_path, m_requestedSize));
+    }
+
+signals:
+    void done(QImage image);
+
+private:
+    WallpaperProvider *m_provider;
+    QString m_path;
+    QSize m_requestedSize;
+};
+
+/*!
+    A texture of its own (wallpapers are much too big for the atlas),
+    which is opaque unless the picture has transparency.
+*/
+class WallpaperTextureFactory : public QQuickTextureFactory
+{
+public:
+    explicit WallpaperTextureFactory(const QImage &image)
+      : m_image(image) { }
+
+    QSGTexture *createTexture(QQuickWindow *window) const Q_DECL_OVERRIDE
+    {
+        return window->createTextureFromImage(m_image, m_image.hasAlphaChannel() ?
+                                                  QQuickWindow::TextureHasAlphaChannel : QQuickWindow::CreateTextureOptions());
+    }
+
+    QSize textureSize() const Q_DECL_OVERRIDE { return m_image.size(); }
+    int textureByteCount() const Q_DECL_OVERRIDE { return int(m_image.sizeInBytes()); }
+    QImage image() const Q_DECL_OVERRIDE { return m_image; }
+
+private:
+    QImage m_image;
+};
+
+class WallpaperResponse : public QQuickImageResponse
+{
+public:
+    WallpaperResponse(WallpaperProvider *provider, QThreadPool *pool, const QString &path, const QSize &requestedSize)
+    {
+        WallpaperLoader *loader = new WallpaperLoader(provider, path, requestedSize);
+        connect(loader, &WallpaperLoader::done, this, &WallpaperResponse::handleDone);
+        pool->start(loader);
+    }
+
+    QQuickTextureFactory *textureFactory() const Q_DECL_OVERRIDE
+    {
+        if (m_image.isNull())
+            return nullptr;
+        return new WallpaperTextureFactory(m_image);
+    }
+
+    void handleDone(QImage image)
+    {
+        m_image = image;
+        emit finished();
+    }
+
+private:
+    QImage m_image;
+};
+
+WallpaperProvider::WallpaperProvider()
+  : m_diskCacheDir(QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) +
+                   QLatin1String("/grefsen/wallpapers/"))
+{
+    QDir().mkpath(m_diskCacheDir);
+    // one at a time: the second output's request waits for the first one's decoding, and then finds its size ready
+    m_pool.setMaxThreadCount(1);
+    // on the GUI thread; QScreen is not to be used from the loader thread
+    const QList<QScreen *> screens = QGuiApplication::screens();
+    for (const QScreen *screen : screens) {
+        const QSize size = (QSizeF(screen->size()) * screen->devicePixelRatio()).toSize();
+        if (!m_screenSizes.contains(size))
+            m_screenSizes << size;
+    }
+}
+
+WallpaperProvider::~WallpaperProvider()
+{
+    m_pool.waitForDone();
+}
+
+QQuickImageResponse *WallpaperProvider::requestImageResponse(const QString &id, const QSize &requestedSize)
+{
+    return new WallpaperResponse(this, &m_pool, id, requestedSize);
+}
+
+QImage WallpaperProvider::image(const QString &path, const QSize &requestedSize)
+{
+    const QFileInfo info(path);
+    if (!info.isFile()) {
+        qWarning() << "wallpaper not found:" << path;
+        return QImage();
+    }
+    const QSize size = requestedSize.isValid() && !requestedSize.isEmpty() ? requestedSize : m_screenSizes.value(0);
+    if (size.isEmpty())
+        return QImage(path);
+    const qint64 modified = info.lastModified().toMSecsSinceEpoch();
+    // Qt Quick's pixmap cache keeps what's on screen; a screen-sized file loads quickly enough otherwise
+    QImage ret = loadFromDisk(path, size, modified);
+    if (!ret.isNull())
+        return ret;
+
+    // decode it once, only as big as the biggest screen needs, and make every size from that
+    QElapsedTimer timer;
+    timer.start();
+    QList<QSize> sizes = m_screenSizes;
+    if (!sizes.contains(size))
+        sizes.prepend(size);
+    QImageReader reader(path);
+    const QSize sourceSize = reader.size();
+    if (sourceSize.isValid()) {
+        QSize needed;
+        for (const QSize &s : qAsConst(sizes))
+            needed = needed.expandedTo(sourceSize.scaled(s, Qt::KeepAspectRatioByExpanding));
+        if (needed.width() < sourceSize.width())
+            reader.setScaledSize(needed);
+    }
+    const QImage source = reader.read();
+    if (source.isNull()) {
+        qWarning() << "failed to read wallpaper" << path << reader.errorString();
+        return QImage();
+    }
+    for (const QSize &s : qAsConst(sizes)) {
+        QImage scaled = cropScaled(source, s);
+        if (s == size)
+            ret = scaled;
+        if (!QFile::exists(diskCachePath(path, s, modified, scaled.hasAlphaChannel())))
+            saveToDisk(scaled, path, modified);
+    }
+    pruneDiskCache(path, modified);
+    qCDebug(lcWallpaper) << "decoded wallpaper" << path << sourceSize << "as" << source.size() << "for" << sizes
+             << "in" << timer.elapsed() << "ms";
+    return ret;
+}
+
+// fills the size, cutting off what's outside it, centered
+QImage WallpaperProvider::cropScaled(const QImage &source, const QSize &size) const
+{
+    const QImage scaled = source.scaled(size, Qt::KeepAspectRatioByExpanding, Qt::SmoothTransformation);
+    const QImage ret = scaled.copy((scaled.width() - size.width()) / 2, (scaled.height() - size.height()) / 2,
+                                   size.width(), size.height());
+    return ret.convertToFormat(ret.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32);
+}
+
+QImage WallpaperProvider::loadFromDisk(const QString &path, const QSize &size, qint64 modified) const
+{
+    QImage ret(diskCachePath(path, size, modified, false));
+    if (ret.isNull())
+        ret = QImage(diskCachePath(path, size, modified, true));
+    if (ret.isNull() || ret.size() != size)
+        return QImage();
+    return ret.convertToFormat(ret.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32);
+}
+
+// JPEG decodes much faster than PNG at screen sizes; PNG only for transparency
+void WallpaperProvider::saveToDisk(const QImage &image, const QString &path, qint64 modified) const
+{
+    const bool alpha = image.hasAlphaChannel();
+    const QString cachePath = diskCachePath(path, image.size(), modified, alpha);
+    QSaveFile f(cachePath);
+    if (!f.open(QIODevice::WriteOnly) || !image.save(&f, alpha ? "PNG" : "JPG", alpha ? -1 : JpegQuality) || !f.commit())
+        qWarning() << "failed to write wallpaper cache" << cachePath;
+}
+
+// <hash of the path>-<width>x<height>-<modification time>, so that the versions of one picture can be found
+QString WallpaperProvider::diskCachePath(const QString &path, const QSize &size, qint64 modified, bool alpha) const
+{
+    return m_diskCacheDir + pathHash(path) + QLatin1Char('-') + QString::number(size.width()) + QLatin1Char('x') +
+            QString::number(size.height()) + QLatin1Char('-') + QString::number(modified) +
+            (alpha ? QLatin1String(".png") : QLatin1String(".jpg"));
+}
+
+QString WallpaperProvider::pathHash(const QString &path) const
+{
+    return QString::fromLatin1(QCryptographicHash::hash(path.toUtf8(), QCryptographicHash::Sha1).toHex());
+}
+
+// the picture has been changed since these were made; they will never be used again
+void WallpaperProvider::pruneDiskCache(const QString &path, qint64 modified) const
+{
+    QDir dir(m_diskCacheDir);
+    const QString current = QString::number(modified);
+    const QStringList files = dir.entryList(QStringList() << pathHash(path) + QLatin1String("-*"), QDir::Files);
+    for (const QString &file : files) {
+        if (file.section(QLatin1Char('-'), 2, 2).section(QLatin1Char('.'), 0, 0) == current)
+            continue;
+        qCDebug(lcWallpaper) << "removing outdated" << file << "of" << path;
+        dir.remove(file);
+    }
+}
+
+#include "wallpaperprovider.moc"
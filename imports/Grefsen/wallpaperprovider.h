@@ -0,0 +1,49 @@
+#ifndef WALLPAPERPROVIDER_H
+#define WALLPAPERPROVIDER_H
+
+#include <QImage>
+#include <QList>
+#include <QQuickImageProvider>
+#include <QThreadPool>
+
+/*!
+    Provides image://wallpaper/ URLs: an absolute path to a picture, cropped
+    and scaled to fill exactly the requested size (set the Image's
+    sourceSize to its own size; Qt Quick multiplies it by the device pixel
+    ratio).
+
+    The first time a picture is needed, it is decoded once, on a single
+    loader thread, no bigger than the largest screen needs; versions for
+    the requested size and each distinct screen size are made from that
+    and written to ~/.cache/grefsen/wallpapers, keyed by the picture's
+    path and modification time, replacing those of an older version of
+    the same picture. After that, each output loads only a
+    screen-sized image, and outputs of the same size share one copy of it
+    in Qt Quick's pixmap cache; each window still uploads its own texture,
+    but only as big as the screen, not the picture.
+*/
+class WallpaperProvider : public QQuickAsyncImageProvider
+{
+public:
+    WallpaperProvider();
+    ~WallpaperProvider();
+
+    QQuickImageResponse *requestImageResponse(const QString &id, const QSize &requestedSize) Q_DECL_OVERRIDE;
+
+    QImage image(const QString &path, const QSize &requestedSize);
+
+protected:
+    QImage cropScaled(const QImage &source, const QSize &size) const;
+    QImage loadFromDisk(const QString &path, const QSize &size, qint64 modified) const;
+    void saveToDisk(const QImage &image, const QString &path, qint64 modified) const;
+    QString diskCachePath(const QString &path, const QSize &size, qint64 modified, bool alpha) const;
+    QString pathHash(const QString &path) const;
+    void pruneDiskCache(const QString &path, qint64 modified) const;
+
+protected:
+    QThreadPool m_pool;
+    QString m_diskCacheDir;
+    QList<QSize> m_screenSizes; // in device pixels
+};
+
+#endif // WALLPAPERPROVIDER_H